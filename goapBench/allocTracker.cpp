@@ -0,0 +1,55 @@
+#include "allocTracker.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+// every block is prefixed with its size, header is kept max aligned so returned pointers stay aligned too
+constexpr size_t alloc_header_size = alignof(std::max_align_t);
+
+static std::atomic<size_t> allocated = 0;
+static std::atomic<size_t> peakAllocated = 0;
+
+static void *tracked_alloc(size_t size)
+{
+  void *mem = std::malloc(size + alloc_header_size);
+  if (!mem)
+    throw std::bad_alloc();
+  *static_cast<size_t*>(mem) = size;
+  const size_t cur = allocated += size;
+  size_t peak = peakAllocated.load();
+  while (cur > peak && !peakAllocated.compare_exchange_weak(peak, cur))
+    ;
+  return static_cast<char*>(mem) + alloc_header_size;
+}
+
+static void tracked_free(void *ptr)
+{
+  if (!ptr)
+    return;
+  void *mem = static_cast<char*>(ptr) - alloc_header_size;
+  allocated -= *static_cast<size_t*>(mem);
+  std::free(mem);
+}
+
+void *operator new(size_t size) { return tracked_alloc(size); }
+void *operator new[](size_t size) { return tracked_alloc(size); }
+void operator delete(void *ptr) noexcept { tracked_free(ptr); }
+void operator delete[](void *ptr) noexcept { tracked_free(ptr); }
+void operator delete(void *ptr, size_t) noexcept { tracked_free(ptr); }
+void operator delete[](void *ptr, size_t) noexcept { tracked_free(ptr); }
+
+void reset_peak_allocated()
+{
+  peakAllocated = allocated.load();
+}
+
+size_t get_allocated()
+{
+  return allocated;
+}
+
+size_t get_peak_allocated()
+{
+  return peakAllocated;
+}
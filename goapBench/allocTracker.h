@@ -0,0 +1,7 @@
+#pragma once
+#include <cstddef>
+
+// Global operator new/delete are replaced in this executable to keep track of heap usage.
+void reset_peak_allocated();
+size_t get_allocated();
+size_t get_peak_allocated();
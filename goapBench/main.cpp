@@ -0,0 +1,247 @@
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "goapPlanner.h"
+#include "goapPlanSearch.h"
+#include "goapHtn.h"
+#include "goapDomains.h"
+#include "allocTracker.h"
+#include "synthDomain.h"
+
+using BenchClock = std::chrono::steady_clock;
+
+using PlanFunc = float(*)(const goap::Planner &planner, const goap::WorldState &from, const goap::WorldState &to,
+                          std::vector<goap::PlanStep> &plan, goap::PlanStats *stats);
+
+struct BenchCase
+{
+  std::string name;
+  goap::Planner planner;
+  goap::WorldState from;
+  goap::WorldState to;
+  PlanFunc staticPlan = nullptr; // only for domains known at build time
+};
+
+struct BenchPlanner
+{
+  const char *name;
+  PlanFunc plan;
+  bool usesPatterns = true; // planner without heuristic tables is used otherwise
+};
+
+constexpr double min_bench_time_ms = 50.0;
+// IDA* doesn't remember visited states and explodes on bigger domains, it's only run where A* is cheap
+constexpr size_t max_ida_reference_nodes = 200;
+
+static float plan_time_sliced(const goap::Planner &planner, const goap::WorldState &from, const goap::WorldState &to,
+                              std::vector<goap::PlanStep> &plan, goap::PlanStats *stats)
+{
+  goap::PlanSearch search = goap::begin_plan_search(planner, from, to);
+  while (goap::step_plan_search(search, 64) == goap::PS_IN_PROGRESS)
+    ;
+  if (stats)
+    stats->numExpanded += search.numExpanded;
+  return search.status == goap::PS_FOUND ? goap::get_best_plan(search, plan) : 0.f;
+}
+
+static const BenchPlanner bench_planners[] = {
+  {"a*", goap::make_plan},
+  {"a* no pdb", goap::make_plan, false},
+  {"ida*", goap::make_plan_ida},
+  {"regressive", goap::make_plan_regressive},
+  {"auto", goap::make_plan_auto},
+  {"time-sliced", plan_time_sliced},
+};
+
+// Calls the function until min_bench_time_ms passes, returns time per call in ns.
+template<typename Callable>
+static double measure_ns_per_call(Callable c)
+{
+  size_t iterations = 0;
+  const BenchClock::time_point start = BenchClock::now();
+  std::chrono::duration<double, std::milli> elapsed{};
+  do
+  {
+    c();
+    iterations++;
+    elapsed = BenchClock::now() - start;
+  } while (elapsed.count() < min_bench_time_ms);
+  return elapsed.count() * 1e6 / double(iterations);
+}
+
+static void run_planner(const char *name, PlanFunc plan_func, const goap::Planner &planner, const BenchCase &bench,
+                        float reference_cost)
+{
+  std::vector<goap::PlanStep> plan;
+  goap::PlanStats stats;
+  const size_t allocatedBefore = get_allocated();
+  reset_peak_allocated();
+  // IDA* reports cost of the found plan negated
+  const float cost = std::abs(plan_func(planner, bench.from, bench.to, plan, &stats));
+  const size_t peakBytes = get_peak_allocated() - allocatedBefore;
+
+  // warm: heuristic tables of the goal are cached by the first plan
+  const double nsPerPlan = measure_ns_per_call([&]()
+  {
+    plan.clear();
+    plan_func(planner, bench.from, bench.to, plan, nullptr);
+  });
+  // cold: goal distances are searched by every plan, like the first plan towards a new goal
+  goap::Planner coldPlanner = planner;
+  const double nsPerColdPlan = !planner.heuristicTables ? nsPerPlan : measure_ns_per_call([&]()
+  {
+    coldPlanner.heuristicTables = std::make_shared<goap::HeuristicTables>();
+    coldPlanner.heuristicTables->patterns = planner.heuristicTables->patterns;
+    coldPlanner.heuristicTables->built = planner.heuristicTables->built;
+    plan.clear();
+    plan_func(coldPlanner, bench.from, bench.to, plan, nullptr);
+  });
+  const double nsPerNode = stats.numExpanded ? nsPerPlan / double(stats.numExpanded) : 0.0;
+  printf("  %-12s %10.1f us/plan %10.1f us cold %8zu nodes %8.1f ns/node %10zu bytes peak  cost %5.1f %s\n",
+         name, nsPerPlan * 1e-3, nsPerColdPlan * 1e-3, stats.numExpanded, nsPerNode, peakBytes, double(cost),
+         cost == reference_cost ? "ok" : "MISMATCH");
+}
+
+static void run_bench_case(const BenchCase &bench)
+{
+  goap::Planner plannerNoPatterns = bench.planner;
+  plannerNoPatterns.heuristicTables.reset();
+
+  // patterns are built once per planner, before its first plan
+  goap::Planner tablesPlanner = bench.planner;
+  const double nsPerTables = measure_ns_per_call([&]() { goap::build_heuristic_tables(tablesPlanner); });
+
+  std::vector<goap::PlanStep> plan;
+  goap::PlanStats referenceStats;
+  const float referenceCost = goap::make_plan(bench.planner, bench.from, bench.to, plan, &referenceStats);
+  printf("%s: %zu states, %zu actions, optimal cost %.1f, heuristic tables %.1f us\n", bench.name.c_str(),
+         bench.planner.wdesc.size(), bench.planner.actions.size(), double(referenceCost), nsPerTables * 1e-3);
+  for (const BenchPlanner &planner : bench_planners)
+  {
+    if (planner.plan == goap::make_plan_ida && referenceStats.numExpanded > max_ida_reference_nodes)
+    {
+      printf("  %-12s skipped\n", planner.name);
+      continue;
+    }
+    run_planner(planner.name, planner.plan, planner.usesPatterns ? bench.planner : plannerNoPatterns, bench, referenceCost);
+  }
+  if (bench.staticPlan)
+    run_planner("static", bench.staticPlan, bench.planner, bench, referenceCost);
+}
+
+template<const auto &Domain>
+static BenchCase make_static_bench_case(const char *name, const goap::WorldStateList &from, const goap::WorldStateList &to)
+{
+  BenchCase res;
+  res.name = name;
+  res.planner = goap::create_planner_from_static(Domain);
+  res.from = goap::produce_planner_worldstate(res.planner, from);
+  res.to = goap::produce_planner_worldstate(res.planner, to);
+  res.staticPlan = [](const goap::Planner &planner, const goap::WorldState &from, const goap::WorldState &to,
+                      std::vector<goap::PlanStep> &plan, goap::PlanStats *stats)
+  {
+    return goap::make_static_plan<Domain>(planner, from, to, plan, stats);
+  };
+  return res;
+}
+
+// loot and escape task split into one subgoal per loot, so every search is only a few actions deep
+static goap::HtnDomain create_looter_htn(const goap::Planner &planner)
+{
+  const goap::WorldState any = goap::produce_planner_worldstate(planner, {});
+  goap::HtnDomain htn;
+  goap::add_htn_subgoal(htn, "loot_once", [&planner](const goap::WorldState &from)
+  {
+    return goap::produce_planner_worldstate(planner, {{"num_loot", from[looter_goap::num_loot] + 1}, {"health_state", Healthy}});
+  });
+  goap::add_htn_subgoal(htn, "escape", [&planner](const goap::WorldState &)
+  {
+    return goap::produce_planner_worldstate(planner, {{"escaped", 1}, {"health_state", Healthy}});
+  });
+  goap::add_htn_method(htn, "collect_loot", goap::produce_planner_worldstate(planner, {{"num_loot", 5}}), {});
+  goap::add_htn_method(htn, "collect_loot", any, {"loot_once", "collect_loot"});
+  goap::add_htn_method(htn, "loot_and_escape", any, {"collect_loot", "escape"});
+  return htn;
+}
+
+static void bench_flat_vs_htn(const BenchCase &bench, size_t iterations)
+{
+  const goap::HtnDomain htn = create_looter_htn(bench.planner);
+  std::vector<goap::PlanStep> plan;
+  goap::PlanStats flatStats;
+  goap::PlanStats htnStats;
+  const float flatCost = goap::make_plan(bench.planner, bench.from, bench.to, plan, &flatStats);
+  plan.clear();
+  const float htnCost = goap::make_htn_plan(bench.planner, htn, "loot_and_escape", bench.from, plan, &htnStats);
+  const size_t htnSteps = plan.size();
+
+  const BenchClock::time_point flatStart = BenchClock::now();
+  for (size_t i = 0; i < iterations; ++i)
+  {
+    plan.clear();
+    goap::make_plan(bench.planner, bench.from, bench.to, plan);
+  }
+  const BenchClock::time_point htnStart = BenchClock::now();
+  for (size_t i = 0; i < iterations; ++i)
+  {
+    plan.clear();
+    goap::make_htn_plan(bench.planner, htn, "loot_and_escape", bench.from, plan);
+  }
+  const std::chrono::duration<double, std::micro> flatTime = htnStart - flatStart;
+  const std::chrono::duration<double, std::micro> htnTime = BenchClock::now() - htnStart;
+  printf("%s flat vs hierarchical:\n", bench.name.c_str());
+  printf("  %-12s %10.1f us/plan %8zu nodes  cost %5.1f\n", "flat",
+         flatTime.count() / double(iterations), flatStats.numExpanded, double(flatCost));
+  printf("  %-12s %10.1f us/plan %8zu nodes  cost %5.1f (%zu steps)\n", "htn",
+         htnTime.count() / double(iterations), htnStats.numExpanded, double(htnCost), htnSteps);
+}
+
+// usage: goap_bench [seed] [synthetic domains count]
+int main(int argc, const char **argv)
+{
+  const uint32_t seed = argc > 1 ? uint32_t(strtoul(argv[1], nullptr, 10)) : 0;
+  const size_t numSynthetic = argc > 2 ? strtoul(argv[2], nullptr, 10) : 6;
+
+  run_bench_case(make_static_bench_case<enemy_goap::domain>("enemy",
+      {{"enemy_vis", 0},
+       {"enemy_alive", 1},
+       {"have_melee", 0},
+       {"have_ranged", 0},
+       {"enemy_dist", DistFar},
+       {"health_state", Healthy}},
+      {{"enemy_alive", 0}, {"health_state", Healthy}}));
+
+  const BenchCase looter = make_static_bench_case<looter_goap::domain>("looter",
+      {{"enemy_vis", 0},
+       {"loot_vis", 1},
+       {"num_loot", 0},
+       {"have_melee", 1},
+       {"have_ranged", 1},
+       {"enemy_dist", DistFar},
+       {"health_state", Healthy},
+       {"escaped", 0}},
+      {{"num_loot", 5}, {"escaped", 1}, {"health_state", Healthy}});
+  run_bench_case(looter);
+  bench_flat_vs_htn(looter, 100);
+  BenchCase looterNoPatterns = looter;
+  looterNoPatterns.name = "looter (no pdb)";
+  looterNoPatterns.planner.heuristicTables.reset();
+  bench_flat_vs_htn(looterNoPatterns, 100);
+
+  // domains grow with the index so the same seed gives comparable runs
+  for (size_t i = 0; i < numSynthetic; ++i)
+  {
+    SynthDomainParams params;
+    params.numStates = 6 + i * 2;
+    params.numActions = 12 + i * 6;
+    params.walkLength = 8 + i * 2;
+    params.seed = seed + uint32_t(i);
+    SynthDomain domain = generate_synth_domain(params);
+    run_bench_case({"synthetic #" + std::to_string(i), std::move(domain.planner), domain.from, domain.to});
+  }
+  return 0;
+}
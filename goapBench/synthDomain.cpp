@@ -0,0 +1,79 @@
+#include "synthDomain.h"
+#include <algorithm>
+#include <numeric>
+#include <random>
+#include <string>
+
+static std::vector<size_t> pick_states(std::mt19937 &rng, size_t num_states, size_t count)
+{
+  std::vector<size_t> states(num_states);
+  std::iota(states.begin(), states.end(), size_t(0));
+  std::shuffle(states.begin(), states.end(), rng);
+  states.resize(std::min(count, num_states));
+  return states;
+}
+
+SynthDomain generate_synth_domain(const SynthDomainParams &params)
+{
+  std::mt19937 rng(params.seed);
+  auto randValue = [&]() { return std::uniform_int_distribution<int>(0, params.maxValue)(rng); };
+  auto randCount = [&](size_t from, size_t to) { return std::uniform_int_distribution<size_t>(from, to)(rng); };
+
+  SynthDomain res;
+  std::vector<std::string> stateNames;
+  for (size_t i = 0; i < params.numStates; ++i)
+    stateNames.push_back("s" + std::to_string(i));
+  res.planner = goap::create_planner();
+  goap::add_states_to_planner(res.planner, stateNames);
+
+  for (size_t actId = 0; actId < params.numActions; ++actId)
+  {
+    // a quarter of actions has no preconditions (but the values its additive effects shift) so random walk always has
+    // somewhere to go
+    const size_t numPreconds = actId % 4 == 0 ? 0 : randCount(1, params.maxPreconds);
+    goap::Precond precond;
+    for (size_t st : pick_states(rng, params.numStates, numPreconds))
+      precond.push_back({stateNames[st].c_str(), randValue()});
+    goap::Effect effect;
+    goap::Effect additiveEffect;
+    for (size_t st : pick_states(rng, params.numStates, randCount(1, params.maxEffects)))
+    {
+      if (params.maxValue > 0 && std::uniform_real_distribution<float>(0.f, 1.f)(rng) < params.additiveChance)
+      {
+        // values are kept in [0, maxValue], a negative one would be "don't care" in a goal taken from the walk,
+        // so the action requires a value it can shift and is invalid at the bounds
+        auto itf = std::find_if(precond.begin(), precond.end(),
+                                [&](const goap::StateDesc &cond) { return cond.first == stateNames[st]; });
+        if (itf == precond.end())
+          itf = precond.insert(precond.end(), {stateNames[st].c_str(), randValue()});
+        const int delta = itf->second == 0 ? 1 : itf->second == params.maxValue ? -1 : rng() % 2 ? 1 : -1;
+        additiveEffect.push_back({stateNames[st].c_str(), delta});
+      }
+      else
+        effect.push_back({stateNames[st].c_str(), randValue()});
+    }
+    const std::string name = "a" + std::to_string(actId);
+    goap::add_action_to_planner(res.planner, name.c_str(), float(randCount(1, 5)), precond, effect, additiveEffect);
+  }
+  goap::build_heuristic_tables(res.planner);
+
+  res.from.resize(params.numStates);
+  for (int8_t &val : res.from)
+    val = int8_t(randValue());
+  goap::WorldState st = res.from;
+  for (size_t step = 0; step < params.walkLength; ++step)
+  {
+    const std::vector<size_t> transitions = goap::find_valid_state_transitions(res.planner, st);
+    if (transitions.empty())
+      break;
+    st = goap::apply_action(res.planner, transitions[rng() % transitions.size()], st);
+  }
+  // states changed by the walk go first, otherwise goal is often satisfied from the start
+  std::vector<size_t> goalStates = pick_states(rng, params.numStates, params.numStates);
+  std::stable_partition(goalStates.begin(), goalStates.end(), [&](size_t i) { return st[i] != res.from[i]; });
+  goalStates.resize(std::min(params.numGoalStates, goalStates.size()));
+  res.to.assign(params.numStates, int8_t(-1));
+  for (size_t i : goalStates)
+    res.to[i] = st[i];
+  return res;
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include <cstdint>
+
+#include "goapPlanner.h"
+
+struct SynthDomainParams
+{
+  size_t numStates = 8;
+  size_t numActions = 16;
+  int8_t maxValue = 2; // values are generated in [0, maxValue]
+  size_t maxPreconds = 3;
+  size_t maxEffects = 2;
+  float additiveChance = 0.2f; // chance of an effect being +1/-1 instead of setting a value
+  size_t numGoalStates = 3;
+  size_t walkLength = 12;
+  uint32_t seed = 0;
+};
+
+struct SynthDomain
+{
+  goap::Planner planner;
+  goap::WorldState from;
+  goap::WorldState to;
+};
+
+// Random domain with a goal which is known to be reachable: it is taken from the end of a random walk
+// over valid actions starting at `from`.
+SynthDomain generate_synth_domain(const SynthDomainParams &params);
@@ -0,0 +1,155 @@
+#include "araStar.h"
+#include "gridComponents.h"
+#include <algorithm>
+#include <cmath>
+
+constexpr float infinity = std::numeric_limits<float>::infinity();
+// reading the clock is slower than an expansion, so it's only checked once in a while
+constexpr size_t expansions_per_deadline_check = 64;
+
+static float heuristic(const nav::AraStar &ara, uint32_t tile)
+{
+  const float dx = float(int(tile % ara.map.width) - ara.to.x);
+  const float dy = float(int(tile / ara.map.width) - ara.to.y);
+  return sqrtf(dx * dx + dy * dy);
+}
+
+static bool test_bit(const std::vector<uint64_t> &bits, uint32_t tile) { return (bits[tile / 64] >> (tile % 64)) & 1; }
+static void set_bit(std::vector<uint64_t> &bits, uint32_t tile) { bits[tile / 64] |= uint64_t(1) << (tile % 64); }
+
+static uint32_t get_goal_tile(const nav::AraStar &ara)
+{
+  return uint32_t(size_t(ara.to.y) * ara.map.width + size_t(ara.to.x));
+}
+
+// Returns false if the deadline passed before the pass finished.
+static bool improve_path(nav::AraStar &ara, nav::AraClock::time_point deadline, const nav::ExpandCallback &on_expand)
+{
+  const uint32_t goalTile = get_goal_tile(ara);
+  for (size_t numExpanded = 0; !is_open_heap_empty(ara.open); ++numExpanded)
+  {
+    // goal's f is just its g, nothing in open can make it better any more
+    if (ara.g[goalTile] <= ara.open.entries.front().f)
+      return true;
+    if (numExpanded % expansions_per_deadline_check == expansions_per_deadline_check - 1 &&
+        nav::AraClock::now() >= deadline)
+      return false;
+    const uint32_t cur = nav::pop_open_tile(ara.open);
+    set_bit(ara.closed, cur);
+    const float curG = ara.g[cur];
+    if (on_expand)
+      on_expand(cur, curG);
+    const int x = int(cur % ara.map.width);
+    const int y = int(cur / ara.map.width);
+    auto checkNeighbour = [&](int nx, int ny)
+    {
+      if (nx < 0 || ny < 0 || nx >= int(ara.map.width) || ny >= int(ara.map.height))
+        return;
+      const uint32_t tile = uint32_t(size_t(ny) * ara.map.width + size_t(nx));
+      const float gScore = curG + nav::get_tile_cost(ara.map, tile);
+      if (gScore >= ara.g[tile])
+        return;
+      ara.g[tile] = gScore;
+      ara.parent[tile] = cur;
+      if (!test_bit(ara.closed, tile))
+        nav::push_open_tile(ara.open, tile, gScore + ara.epsilon * heuristic(ara, tile));
+      else if (!test_bit(ara.incons, tile))
+      {
+        set_bit(ara.incons, tile);
+        ara.inconsList.push_back(tile);
+      }
+    };
+    checkNeighbour(x + 1, y + 0);
+    checkNeighbour(x - 1, y + 0);
+    checkNeighbour(x + 0, y + 1);
+    checkNeighbour(x + 0, y - 1);
+  }
+  return true;
+}
+
+static void publish_path(nav::AraStar &ara)
+{
+  const uint32_t goalTile = get_goal_tile(ara);
+  ara.path.clear();
+  if (ara.g[goalTile] == infinity)
+  {
+    ara.bound = infinity;
+    return;
+  }
+  for (uint32_t tile = goalTile; tile != nav::invalid_tile; tile = ara.parent[tile])
+    ara.path.push_back(tile);
+  std::reverse(ara.path.begin(), ara.path.end());
+  // optimal cost is at least the smallest unweighted f among tiles which still can be improved
+  float minF = infinity;
+  for (const nav::OpenEntry &entry : ara.open.entries)
+    minF = std::min(minF, ara.g[entry.tile] + heuristic(ara, entry.tile));
+  for (uint32_t tile : ara.inconsList)
+    minF = std::min(minF, ara.g[tile] + heuristic(ara, tile));
+  ara.bound = minF == infinity ? 1.f : std::max(1.f, std::min(ara.epsilon, ara.g[goalTile] / minF));
+}
+
+// Next pass starts from open and incons tiles with fresh keys, everything else stays as is.
+static void begin_next_pass(nav::AraStar &ara)
+{
+  ara.epsilon = std::max(1.f, ara.epsilon - ara.epsilonStep);
+  std::vector<uint32_t> tiles;
+  tiles.reserve(ara.open.entries.size() + ara.inconsList.size());
+  for (const nav::OpenEntry &entry : ara.open.entries)
+    tiles.push_back(entry.tile);
+  tiles.insert(tiles.end(), ara.inconsList.begin(), ara.inconsList.end());
+  nav::reset_open_heap(ara.open, ara.g.size());
+  for (uint32_t tile : tiles)
+    nav::push_open_tile(ara.open, tile, ara.g[tile] + ara.epsilon * heuristic(ara, tile));
+  std::fill(ara.closed.begin(), ara.closed.end(), 0);
+  std::fill(ara.incons.begin(), ara.incons.end(), 0);
+  ara.inconsList.clear();
+}
+
+void nav::init_ara_star(AraStar &ara, const GridMap &map, GridPos from, GridPos to, float initial_epsilon, float epsilon_step)
+{
+  ara.map = map;
+  ara.from = from;
+  ara.to = to;
+  ara.epsilon = std::max(1.f, initial_epsilon);
+  ara.epsilonStep = epsilon_step;
+  const size_t numTiles = map.width * map.height;
+  ara.g.assign(numTiles, infinity);
+  ara.parent.assign(numTiles, invalid_tile);
+  ara.closed.assign((numTiles + 63) / 64, 0);
+  ara.incons.assign((numTiles + 63) / 64, 0);
+  ara.inconsList.clear();
+  reset_open_heap(ara.open, numTiles);
+  ara.path.clear();
+  ara.bound = infinity;
+  auto isInside = [&](GridPos p) { return p.x >= 0 && p.y >= 0 && p.x < int(map.width) && p.y < int(map.height); };
+  ara.searching = isInside(from) && isInside(to) && !is_goal_cut_off(map, from, to);
+  ara.done = !ara.searching;
+  if (!ara.searching)
+    return;
+  const uint32_t fromTile = uint32_t(size_t(from.y) * map.width + size_t(from.x));
+  ara.g[fromTile] = 0.f;
+  push_open_tile(ara.open, fromTile, ara.epsilon * heuristic(ara, fromTile));
+}
+
+bool nav::improve_ara_star(AraStar &ara, AraClock::time_point deadline, const ExpandCallback &on_expand)
+{
+  bool changed = false;
+  while (!ara.done)
+  {
+    if (!ara.searching)
+    {
+      begin_next_pass(ara);
+      ara.searching = true;
+    }
+    if (!improve_path(ara, deadline, on_expand))
+      break;
+    ara.searching = false;
+    publish_path(ara);
+    changed = true;
+    // no path is found even with inflated heuristic - there's none at all
+    ara.done = ara.bound <= 1.f || ara.path.empty();
+    if (AraClock::now() >= deadline)
+      break;
+  }
+  return changed;
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "gridSearch.h"
+
+// Anytime repairing A*: finds an epsilon-suboptimal path quickly and keeps improving it, reusing
+// the previous search when epsilon is lowered. Work is split by deadlines, so it can run a bit every frame.
+namespace nav
+{
+  using AraClock = std::chrono::steady_clock;
+
+  struct AraStar
+  {
+    GridMap map{};
+    GridPos from{};
+    GridPos to{};
+    float epsilon = 1.f;
+    float epsilonStep = 0.5f;
+
+    std::vector<float> g;
+    std::vector<uint32_t> parent;
+    std::vector<uint64_t> closed; // bitset
+    std::vector<uint64_t> incons; // bitset of tiles improved after being closed
+    std::vector<uint32_t> inconsList;
+    OpenHeap open; // f = g + epsilon * h
+
+    std::vector<size_t> path; // best path published so far
+    float bound = std::numeric_limits<float>::infinity(); // path cost is at most bound times the optimal one
+    bool searching = false; // improve pass for the current epsilon isn't finished yet
+    bool done = false; // path is optimal or doesn't exist
+  };
+
+  void init_ara_star(AraStar &ara, const GridMap &map, GridPos from, GridPos to, float initial_epsilon, float epsilon_step = 0.5f);
+  // Keeps searching and lowering epsilon until the deadline passes or the path is proven optimal.
+  // Returns true if the published path (or bound) changed.
+  bool improve_ara_star(AraStar &ara, AraClock::time_point deadline, const ExpandCallback &on_expand = nullptr);
+};
@@ -0,0 +1,234 @@
+#include "dstarLite.h"
+#include "gridComponents.h"
+#include <algorithm>
+#include <cstdlib>
+
+constexpr float infinity = std::numeric_limits<float>::infinity();
+
+static bool is_less(const nav::DStarKey &lhs, const nav::DStarKey &rhs)
+{
+  return lhs.primary < rhs.primary || (lhs.primary == rhs.primary && lhs.secondary < rhs.secondary);
+}
+
+static bool is_inside(const nav::DStarLite &dstar, nav::GridPos p)
+{
+  return p.x >= 0 && p.y >= 0 && p.x < int(dstar.map.width) && p.y < int(dstar.map.height);
+}
+
+static uint32_t to_tile(const nav::DStarLite &dstar, nav::GridPos p)
+{
+  return uint32_t(size_t(p.y) * dstar.map.width + size_t(p.x));
+}
+
+static float heuristic(const nav::DStarLite &dstar, uint32_t tile)
+{
+  const int x = int(tile % dstar.map.width);
+  const int y = int(tile / dstar.map.width);
+  return dstar.minTileCost * float(std::abs(x - dstar.start.x) + std::abs(y - dstar.start.y));
+}
+
+static nav::DStarKey calc_key(const nav::DStarLite &dstar, uint32_t tile)
+{
+  const float best = std::min(dstar.g[tile], dstar.rhs[tile]);
+  return {best + heuristic(dstar, tile) + dstar.keyModifier, best};
+}
+
+template<typename Callable>
+static void for_each_neighbour(const nav::DStarLite &dstar, uint32_t tile, Callable c)
+{
+  const size_t x = tile % dstar.map.width;
+  const size_t y = tile / dstar.map.width;
+  if (x + 1 < dstar.map.width)
+    c(tile + 1);
+  if (x > 0)
+    c(tile - 1);
+  if (y + 1 < dstar.map.height)
+    c(uint32_t(tile + dstar.map.width));
+  if (y > 0)
+    c(uint32_t(tile - dstar.map.width));
+}
+
+static void sift_up(nav::DStarLite &dstar, size_t pos)
+{
+  const nav::DStarEntry entry = dstar.queue[pos];
+  while (pos > 0 && is_less(entry.key, dstar.queue[(pos - 1) / 2].key))
+  {
+    dstar.queue[pos] = dstar.queue[(pos - 1) / 2];
+    dstar.queuePos[dstar.queue[pos].tile] = uint32_t(pos);
+    pos = (pos - 1) / 2;
+  }
+  dstar.queue[pos] = entry;
+  dstar.queuePos[entry.tile] = uint32_t(pos);
+}
+
+static void sift_down(nav::DStarLite &dstar, size_t pos)
+{
+  const nav::DStarEntry entry = dstar.queue[pos];
+  while (pos * 2 + 1 < dstar.queue.size())
+  {
+    size_t child = pos * 2 + 1;
+    if (child + 1 < dstar.queue.size() && is_less(dstar.queue[child + 1].key, dstar.queue[child].key))
+      child++;
+    if (!is_less(dstar.queue[child].key, entry.key))
+      break;
+    dstar.queue[pos] = dstar.queue[child];
+    dstar.queuePos[dstar.queue[pos].tile] = uint32_t(pos);
+    pos = child;
+  }
+  dstar.queue[pos] = entry;
+  dstar.queuePos[entry.tile] = uint32_t(pos);
+}
+
+static void remove_from_queue(nav::DStarLite &dstar, uint32_t tile)
+{
+  const uint32_t pos = dstar.queuePos[tile];
+  dstar.queuePos[tile] = nav::invalid_tile;
+  const nav::DStarEntry last = dstar.queue.back();
+  dstar.queue.pop_back();
+  if (pos == dstar.queue.size())
+    return;
+  dstar.queue[pos] = last;
+  sift_up(dstar, pos);
+  sift_down(dstar, dstar.queuePos[last.tile]);
+}
+
+static void set_queue_key(nav::DStarLite &dstar, uint32_t tile, nav::DStarKey key)
+{
+  if (dstar.queuePos[tile] != nav::invalid_tile)
+  {
+    const uint32_t pos = dstar.queuePos[tile];
+    dstar.queue[pos].key = key;
+    sift_up(dstar, pos);
+    sift_down(dstar, dstar.queuePos[tile]);
+    return;
+  }
+  dstar.queue.push_back({key, tile});
+  sift_up(dstar, dstar.queue.size() - 1);
+}
+
+static void update_vertex(nav::DStarLite &dstar, uint32_t tile)
+{
+  if (tile != to_tile(dstar, dstar.goal))
+  {
+    // moving onto a tile costs that tile's cost, walls make the edge infinite
+    float best = infinity;
+    for_each_neighbour(dstar, tile, [&](uint32_t next)
+    {
+      best = std::min(best, nav::get_tile_cost(dstar.map, next) + dstar.g[next]);
+    });
+    dstar.rhs[tile] = best;
+  }
+  if (dstar.g[tile] != dstar.rhs[tile])
+    set_queue_key(dstar, tile, calc_key(dstar, tile));
+  else if (dstar.queuePos[tile] != nav::invalid_tile)
+    remove_from_queue(dstar, tile);
+}
+
+static void compute_shortest_path(nav::DStarLite &dstar, const nav::ExpandCallback &on_expand)
+{
+  const uint32_t startTile = to_tile(dstar, dstar.start);
+  while (!dstar.queue.empty() &&
+         (is_less(dstar.queue.front().key, calc_key(dstar, startTile)) || dstar.rhs[startTile] != dstar.g[startTile]))
+  {
+    const uint32_t tile = dstar.queue.front().tile;
+    const nav::DStarKey oldKey = dstar.queue.front().key;
+    const nav::DStarKey newKey = calc_key(dstar, tile);
+    if (is_less(oldKey, newKey)) // start moved since the tile was queued
+    {
+      set_queue_key(dstar, tile, newKey);
+      continue;
+    }
+    if (on_expand)
+      on_expand(tile, std::min(dstar.g[tile], dstar.rhs[tile]));
+    remove_from_queue(dstar, tile);
+    if (dstar.g[tile] > dstar.rhs[tile])
+      dstar.g[tile] = dstar.rhs[tile]; // overconsistent, settle it
+    else
+    {
+      dstar.g[tile] = infinity; // underconsistent, the tile itself has to be reevaluated too
+      update_vertex(dstar, tile);
+    }
+    for_each_neighbour(dstar, tile, [&](uint32_t prev) { update_vertex(dstar, prev); });
+  }
+}
+
+// Keys queued so far used the heuristic from the old start, instead of requeueing them all
+// new keys are offset by the distance the start moved.
+static void shift_key_modifier(nav::DStarLite &dstar)
+{
+  if (is_inside(dstar, dstar.lastStart))
+    dstar.keyModifier += dstar.minTileCost * float(std::abs(dstar.start.x - dstar.lastStart.x) +
+                                                    std::abs(dstar.start.y - dstar.lastStart.y));
+  dstar.lastStart = dstar.start;
+}
+
+void nav::init_dstar_lite(DStarLite &dstar, const GridMap &map, GridPos start, GridPos goal)
+{
+  dstar.map = map;
+  dstar.start = start;
+  dstar.goal = goal;
+  dstar.lastStart = start;
+  dstar.keyModifier = 0.f;
+  dstar.minTileCost = *std::min_element(map.costs->begin(), map.costs->end());
+  const size_t numTiles = map.width * map.height;
+  dstar.g.assign(numTiles, infinity);
+  dstar.rhs.assign(numTiles, infinity);
+  dstar.queue.clear();
+  dstar.queuePos.assign(numTiles, invalid_tile);
+  if (!is_inside(dstar, goal))
+    return;
+  const uint32_t goalTile = to_tile(dstar, goal);
+  dstar.rhs[goalTile] = 0.f;
+  set_queue_key(dstar, goalTile, calc_key(dstar, goalTile));
+}
+
+void nav::move_dstar_start(DStarLite &dstar, GridPos start)
+{
+  dstar.start = start;
+}
+
+void nav::update_dstar_tile(DStarLite &dstar, size_t tile)
+{
+  if (dstar.g.empty() || !is_inside(dstar, dstar.goal))
+    return;
+  shift_key_modifier(dstar);
+  // only edges leading onto the tile changed, so only its neighbours have a different lookahead
+  for_each_neighbour(dstar, uint32_t(tile), [&](uint32_t prev) { update_vertex(dstar, prev); });
+}
+
+std::vector<size_t> nav::find_dstar_path(DStarLite &dstar, const ExpandCallback &on_expand)
+{
+  if (dstar.g.empty() || !is_inside(dstar, dstar.start) || !is_inside(dstar, dstar.goal))
+    return {};
+  shift_key_modifier(dstar);
+  // the queue is left as is, so the search picks up from there once the goal gets connected
+  if (is_goal_cut_off(dstar.map, dstar.start, dstar.goal))
+    return {};
+  compute_shortest_path(dstar, on_expand);
+
+  uint32_t cur = to_tile(dstar, dstar.start);
+  if (dstar.g[cur] == infinity)
+    return {};
+  // greedy descent over g, bounded in case the map was changed without telling us
+  const uint32_t goalTile = to_tile(dstar, dstar.goal);
+  std::vector<size_t> path = {cur};
+  while (cur != goalTile && path.size() <= dstar.g.size())
+  {
+    uint32_t best = invalid_tile;
+    float bestScore = infinity;
+    for_each_neighbour(dstar, cur, [&](uint32_t next)
+    {
+      const float score = get_tile_cost(dstar.map, next) + dstar.g[next];
+      if (score < bestScore)
+      {
+        best = next;
+        bestScore = score;
+      }
+    });
+    if (best == invalid_tile)
+      return {};
+    cur = best;
+    path.push_back(cur);
+  }
+  return cur == goalTile ? path : std::vector<size_t>();
+}
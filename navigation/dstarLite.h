@@ -0,0 +1,46 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "gridSearch.h"
+
+// D* Lite over a 4-connected grid. The search runs from the goal towards the start and keeps its state,
+// so after tile edits or start moves only the vertices whose distances actually change are repaired.
+namespace nav
+{
+  struct DStarKey
+  {
+    float primary;
+    float secondary;
+  };
+
+  struct DStarEntry
+  {
+    DStarKey key;
+    uint32_t tile;
+  };
+
+  struct DStarLite
+  {
+    GridMap map{};
+    GridPos start{-1, -1};
+    GridPos goal{-1, -1};
+    GridPos lastStart{-1, -1}; // start at the moment of the last repair
+    float keyModifier = 0.f; // km, accumulated heuristic shift from start moves
+    float minTileCost = 1.f; // heuristic scale, keeps it admissible for any cost table
+    std::vector<float> g;
+    std::vector<float> rhs; // one-step lookahead of g
+    std::vector<DStarEntry> queue; // binary heap of inconsistent tiles
+    std::vector<uint32_t> queuePos; // per tile, invalid_tile if it's not queued
+  };
+
+  void init_dstar_lite(DStarLite &dstar, const GridMap &map, GridPos start, GridPos goal);
+  // Cheap, the key modifier takes care of the heuristic change.
+  void move_dstar_start(DStarLite &dstar, GridPos start);
+  // Has to be called after the map tile changed (walls and costs are read from the map directly), components of the
+  // map, if it has them, have to be updated first.
+  void update_dstar_tile(DStarLite &dstar, size_t tile);
+  // Repairs the search and returns tiles from start to goal inclusive, empty if there's no path.
+  std::vector<size_t> find_dstar_path(DStarLite &dstar, const ExpandCallback &on_expand = nullptr);
+};
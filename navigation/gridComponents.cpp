@@ -0,0 +1,114 @@
+#include "gridComponents.h"
+#include <algorithm>
+#include <initializer_list>
+
+static uint32_t find_label_root(std::vector<uint32_t> &parents, uint32_t label)
+{
+  while (parents[label] != label)
+  {
+    parents[label] = parents[parents[label]]; // path halving
+    label = parents[label];
+  }
+  return label;
+}
+
+// Label of a new walkable tile joining the labelled neighbours, a new one if it has none.
+static uint32_t join_neighbour_labels(nav::GridComponents &components, std::initializer_list<uint32_t> neighbour_labels)
+{
+  uint32_t label = nav::no_component;
+  for (uint32_t neighbour : neighbour_labels)
+  {
+    if (neighbour == nav::no_component)
+      continue;
+    const uint32_t root = find_label_root(components.labelParents, neighbour);
+    if (label == nav::no_component)
+      label = root;
+    else if (root != label)
+      components.labelParents[root] = label;
+  }
+  if (label != nav::no_component)
+    return label;
+  components.labelParents.push_back(uint32_t(components.labelParents.size()));
+  return components.labelParents.back();
+}
+
+void nav::build_grid_components(const GridMap &map, GridComponents &components)
+{
+  const size_t w = map.width;
+  components.width = map.width;
+  components.height = map.height;
+  components.tileLabels.assign(map.width * map.height, no_component);
+  components.labelParents.clear();
+  std::vector<uint32_t> &labels = components.tileLabels;
+  // a tile joins its left and top neighbours, labels which meet on it are merged
+  for (size_t y = 0; y < map.height; ++y)
+    for (size_t x = 0; x < map.width; ++x)
+    {
+      const size_t tile = y * w + x;
+      if (get_tile_cost(map, tile) == blocked_tile)
+        continue;
+      labels[tile] = join_neighbour_labels(components, {x > 0 ? labels[tile - 1] : no_component,
+                                                        y > 0 ? labels[tile - w] : no_component});
+    }
+  // roots are renumbered densely and tiles point at them directly
+  std::vector<uint32_t> rootIds(components.labelParents.size(), no_component);
+  uint32_t numComponents = 0;
+  for (uint32_t &label : labels)
+  {
+    if (label == no_component)
+      continue;
+    uint32_t &id = rootIds[find_label_root(components.labelParents, label)];
+    if (id == no_component)
+      id = numComponents++;
+    label = id;
+  }
+  components.labelParents.resize(numComponents);
+  for (uint32_t i = 0; i < numComponents; ++i)
+    components.labelParents[i] = i;
+}
+
+void nav::update_grid_components(const GridMap &map, const GridRect &dirty, GridComponents &components)
+{
+  if (components.width != map.width || components.height != map.height)
+  {
+    build_grid_components(map, components);
+    return;
+  }
+  const size_t w = map.width;
+  const int minX = std::max(dirty.minX, 0);
+  const int minY = std::max(dirty.minY, 0);
+  const int maxX = std::min(dirty.maxX, int(map.width));
+  const int maxY = std::min(dirty.maxY, int(map.height));
+  std::vector<size_t> opened;
+  for (int y = minY; y < maxY; ++y)
+    for (int x = minX; x < maxX; ++x)
+    {
+      const size_t tile = size_t(y) * w + size_t(x);
+      const bool walkable = get_tile_cost(map, tile) != blocked_tile;
+      const bool labelled = components.tileLabels[tile] != no_component;
+      // union-find can't split a component, so a closed tile costs a full relabel
+      if (!walkable && labelled)
+      {
+        build_grid_components(map, components);
+        return;
+      }
+      if (walkable && !labelled)
+        opened.push_back(tile);
+    }
+  if (opened.empty())
+    return;
+
+  std::vector<uint32_t> &labels = components.tileLabels;
+  for (size_t tile : opened)
+  {
+    const size_t x = tile % w;
+    const size_t y = tile / w;
+    labels[tile] = join_neighbour_labels(components, {x > 0 ? labels[tile - 1] : no_component,
+                                                      x + 1 < w ? labels[tile + 1] : no_component,
+                                                      y > 0 ? labels[tile - w] : no_component,
+                                                      y + 1 < map.height ? labels[tile + w] : no_component});
+  }
+  // every label points at its root again, so queries don't need to walk the forest
+  for (uint32_t label = 0; label < uint32_t(components.labelParents.size()); ++label)
+    components.labelParents[label] = find_label_root(components.labelParents, label);
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "gridSearch.h"
+
+namespace nav
+{
+  constexpr uint32_t no_component = uint32_t(-1);
+
+  // 4-connected parts of walkable tiles. Tiles keep the label they were given, labels merged later are joined by
+  // union-find over the labels. The label forest is flattened after every change, so queries are two lookups.
+  struct GridComponents
+  {
+    size_t width = 0, height = 0;
+    std::vector<uint32_t> tileLabels; // no_component for blocked tiles
+    std::vector<uint32_t> labelParents; // every label points at its root, roots are the components
+  };
+
+  void build_grid_components(const GridMap &map, GridComponents &components);
+  // Has to be called after tiles inside dirty changed. Opened tiles join the components around them in place,
+  // a closed tile may split its component and then the labels are rebuilt.
+  void update_grid_components(const GridMap &map, const GridRect &dirty, GridComponents &components);
+
+  inline uint32_t get_tile_component(const GridComponents &components, size_t tile)
+  {
+    const uint32_t label = components.tileLabels[tile];
+    return label == no_component ? no_component : components.labelParents[label];
+  }
+
+  // False if either tile is blocked or outside the grid, searches between such tiles can be skipped.
+  inline bool are_tiles_connected(const GridComponents &components, GridPos from, GridPos to)
+  {
+    auto inside = [&](GridPos p)
+    {
+      return p.x >= 0 && p.y >= 0 && size_t(p.x) < components.width && size_t(p.y) < components.height;
+    };
+    if (!inside(from) || !inside(to))
+      return false;
+    const uint32_t fromComponent = get_tile_component(components, size_t(from.y) * components.width + size_t(from.x));
+    return fromComponent != no_component &&
+           fromComponent == get_tile_component(components, size_t(to.y) * components.width + size_t(to.x));
+  }
+
+  // Searches over the map call it first. Nothing is cut off if the map has no components (or stale ones),
+  // a blocked start is left to the search too.
+  inline bool is_goal_cut_off(const GridMap &map, GridPos from, GridPos to)
+  {
+    if (!map.components || map.components->width != map.width || map.components->height != map.height)
+      return false;
+    if (from.x < 0 || from.y < 0 || size_t(from.x) >= map.width || size_t(from.y) >= map.height)
+      return false;
+    if (get_tile_component(*map.components, size_t(from.y) * map.width + size_t(from.x)) == no_component)
+      return false;
+    return !are_tiles_connected(*map.components, from, to);
+  }
+};
@@ -0,0 +1,70 @@
+#include "gridFlood.h"
+#include <algorithm>
+
+void nav::flood_grid(const GridMap &map, const std::vector<GridPos> &sources, const GridRect &limits, GridFlood &flood)
+{
+  flood.limits = limits;
+  const int w = limits.maxX - limits.minX;
+  const int h = limits.maxY - limits.minY;
+  const size_t numTiles = size_t(std::max(w, 0)) * size_t(std::max(h, 0));
+  flood.dist.assign(numTiles, blocked_tile);
+  reset_open_heap(flood.open, numTiles);
+  // indices are local to the limits rect, so a flood over a small cluster only touches small arrays
+  auto toLocal = [&](int x, int y) { return uint32_t((y - limits.minY) * w + x - limits.minX); };
+  for (const GridPos &src : sources)
+  {
+    if (src.x < limits.minX || src.y < limits.minY || src.x >= limits.maxX || src.y >= limits.maxY)
+      continue;
+    flood.dist[toLocal(src.x, src.y)] = 0.f;
+    push_open_tile(flood.open, toLocal(src.x, src.y), 0.f);
+  }
+  while (!is_open_heap_empty(flood.open))
+  {
+    const uint32_t cur = pop_open_tile(flood.open);
+    const float curDist = flood.dist[cur];
+    const int x = limits.minX + int(cur) % w;
+    const int y = limits.minY + int(cur) / w;
+    auto checkNeighbour = [&](int nx, int ny)
+    {
+      if (nx < limits.minX || ny < limits.minY || nx >= limits.maxX || ny >= limits.maxY)
+        return;
+      const float cost = get_tile_cost(map, size_t(ny) * map.width + size_t(nx));
+      const uint32_t tile = toLocal(nx, ny);
+      if (cost == blocked_tile || curDist + cost >= flood.dist[tile])
+        return;
+      flood.dist[tile] = curDist + cost;
+      push_open_tile(flood.open, tile, curDist + cost);
+    };
+    checkNeighbour(x + 1, y + 0);
+    checkNeighbour(x - 1, y + 0);
+    checkNeighbour(x + 0, y + 1);
+    checkNeighbour(x + 0, y - 1);
+  }
+}
+
+std::vector<nav::GridPos> nav::trace_flood_path(const GridMap &map, const GridFlood &flood, GridPos to)
+{
+  const GridRect &limits = flood.limits;
+  if (to.x < limits.minX || to.y < limits.minY || to.x >= limits.maxX || to.y >= limits.maxY ||
+      get_flood_dist(flood, to) == blocked_tile)
+    return {};
+  std::vector<GridPos> path = {to};
+  // the tile was reached from a neighbour whose distance plus the cost of entering it gives exactly its own
+  for (GridPos cur = to; get_flood_dist(flood, cur) > 0.f;)
+  {
+    const float curDist = get_flood_dist(flood, cur);
+    const float cost = get_tile_cost(map, size_t(cur.y) * map.width + size_t(cur.x));
+    const GridPos neighbours[] = {{cur.x + 1, cur.y}, {cur.x - 1, cur.y}, {cur.x, cur.y + 1}, {cur.x, cur.y - 1}};
+    const GridPos *prev = std::find_if(std::begin(neighbours), std::end(neighbours), [&](const GridPos &p)
+    {
+      return p.x >= limits.minX && p.y >= limits.minY && p.x < limits.maxX && p.y < limits.maxY &&
+             get_flood_dist(flood, p) + cost == curDist;
+    });
+    if (prev == std::end(neighbours))
+      return {};
+    cur = *prev;
+    path.push_back(cur);
+  }
+  std::reverse(path.begin(), path.end());
+  return path;
+}
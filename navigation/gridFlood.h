@@ -0,0 +1,28 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+
+#include "gridSearch.h"
+
+namespace nav
+{
+  // Distances from the closest of the sources to every tile inside limits, stored row by row over the limits rect.
+  struct GridFlood
+  {
+    GridRect limits{};
+    std::vector<float> dist; // blocked_tile (infinity) for unreachable tiles
+    OpenHeap open;
+  };
+
+  // Dijkstra over tiles inside limits, all sources start at 0. Sources outside limits are ignored.
+  void flood_grid(const GridMap &map, const std::vector<GridPos> &sources, const GridRect &limits, GridFlood &flood);
+
+  inline float get_flood_dist(const GridFlood &flood, GridPos p)
+  {
+    const int w = flood.limits.maxX - flood.limits.minX;
+    return flood.dist[size_t((p.y - flood.limits.minY) * w + p.x - flood.limits.minX)];
+  }
+
+  // Tiles from the closest source to `to` walking distances back down, empty if `to` wasn't reached.
+  std::vector<GridPos> trace_flood_path(const GridMap &map, const GridFlood &flood, GridPos to);
+};
@@ -0,0 +1,91 @@
+#include "gridSearch.h"
+#include "gridComponents.h"
+#include <algorithm>
+#include <cmath>
+
+static float heuristic(int x, int y, nav::GridPos to)
+{
+  return sqrtf(float(x - to.x) * float(x - to.x) + float(y - to.y) * float(y - to.y));
+}
+
+nav::TileCosts nav::make_tile_costs(std::initializer_list<std::pair<char, float>> costs, float default_cost)
+{
+  TileCosts res;
+  res.fill(default_cost);
+  for (const auto &[symb, cost] : costs)
+    res[uint8_t(symb)] = cost;
+  return res;
+}
+
+void nav::begin_grid_search(GridSearch &search, size_t num_tiles)
+{
+  reset_open_heap(search.open, num_tiles);
+  search.generation++;
+  if (search.stamp.size() == num_tiles && search.generation != 0)
+    return;
+  // map size changed or stamps wrapped around, everything is reset once
+  search.g.resize(num_tiles);
+  search.parent.resize(num_tiles);
+  search.closed.resize((num_tiles + 63) / 64);
+  search.stamp.assign(num_tiles, 0);
+  search.generation = 1;
+}
+
+std::vector<size_t> nav::find_grid_path(const GridMap &map, GridPos from, GridPos to, const GridRect &limits, float weight,
+                                        const ExpandCallback &on_expand)
+{
+  if (from.x < 0 || from.y < 0 || from.x >= int(map.width) || from.y >= int(map.height))
+    return {};
+  if (is_goal_cut_off(map, from, to))
+    return {};
+  thread_local GridSearch search;
+  begin_grid_search(search, map.width * map.height);
+
+  const uint32_t fromTile = uint32_t(size_t(from.y) * map.width + size_t(from.x));
+  const bool toInside = to.x >= 0 && to.y >= 0 && to.x < int(map.width) && to.y < int(map.height);
+  const uint32_t toTile = toInside ? uint32_t(size_t(to.y) * map.width + size_t(to.x)) : invalid_tile;
+  touch_tile(search, fromTile);
+  search.g[fromTile] = 0.f;
+  push_open_tile(search.open, fromTile, weight * heuristic(from.x, from.y, to));
+  while (!is_open_heap_empty(search.open))
+  {
+    const uint32_t cur = pop_open_tile(search.open);
+    if (cur == toTile)
+    {
+      std::vector<size_t> path;
+      for (uint32_t tile = toTile; tile != invalid_tile; tile = search.parent[tile])
+        path.push_back(tile);
+      std::reverse(path.begin(), path.end());
+      return path;
+    }
+    close_tile(search, cur);
+    const float curG = search.g[cur];
+    if (on_expand)
+      on_expand(cur, curG);
+    const int x = int(cur % map.width);
+    const int y = int(cur / map.width);
+    auto checkNeighbour = [&](int nx, int ny)
+    {
+      if (nx < limits.minX || ny < limits.minY || nx >= limits.maxX || ny >= limits.maxY)
+        return;
+      const uint32_t tile = uint32_t(size_t(ny) * map.width + size_t(nx));
+      const float edgeWeight = get_tile_cost(map, tile);
+      if (edgeWeight == blocked_tile)
+        return;
+      touch_tile(search, tile);
+      const float gScore = curG + edgeWeight;
+      if (gScore >= search.g[tile])
+        return;
+      // closed tiles only get a better parent, they are never reopened
+      search.g[tile] = gScore;
+      search.parent[tile] = cur;
+      if (!is_tile_closed(search, tile))
+        push_open_tile(search.open, tile, gScore + weight * heuristic(nx, ny, to));
+    };
+    checkNeighbour(x + 1, y + 0);
+    checkNeighbour(x - 1, y + 0);
+    checkNeighbour(x + 0, y + 1);
+    checkNeighbour(x + 0, y - 1);
+  }
+  return {};
+}
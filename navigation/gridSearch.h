@@ -0,0 +1,79 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include "openHeap.h"
+
+namespace nav
+{
+  constexpr float blocked_tile = std::numeric_limits<float>::infinity();
+
+  // Cost of stepping onto a tile indexed by its symbol, blocked_tile for walls.
+  using TileCosts = std::array<float, 256>;
+  TileCosts make_tile_costs(std::initializer_list<std::pair<char, float>> costs, float default_cost = 1.f);
+
+  struct GridPos
+  {
+    int x, y;
+  };
+
+  struct GridRect
+  {
+    int minX, minY;
+    int maxX, maxY; // exclusive
+  };
+
+  struct GridComponents;
+
+  struct GridMap
+  {
+    const char *tiles;
+    size_t width;
+    size_t height;
+    const TileCosts *costs;
+    const GridComponents *components = nullptr; // optional, searches towards other components return right away
+  };
+
+  inline float get_tile_cost(const GridMap &map, size_t tile) { return (*map.costs)[uint8_t(map.tiles[tile])]; }
+
+  // Per tile data of a search, g and parent are updated in place. Buffers are kept between searches
+  // and invalidated lazily: a tile's data is only valid if its stamp matches the current generation,
+  // so starting a search costs O(explored) instead of O(W*H).
+  struct GridSearch
+  {
+    std::vector<float> g;
+    std::vector<uint32_t> parent;
+    std::vector<uint64_t> closed; // bitset, bits of stale tiles are cleared on touch
+    std::vector<uint32_t> stamp;
+    uint32_t generation = 0;
+    OpenHeap open;
+  };
+
+  void begin_grid_search(GridSearch &search, size_t num_tiles);
+  // Must be called before tile data is read in the current search.
+  inline void touch_tile(GridSearch &search, uint32_t tile)
+  {
+    if (search.stamp[tile] == search.generation)
+      return;
+    search.stamp[tile] = search.generation;
+    search.g[tile] = std::numeric_limits<float>::max();
+    search.parent[tile] = invalid_tile;
+    search.closed[tile / 64] &= ~(uint64_t(1) << (tile % 64));
+  }
+  inline bool is_tile_closed(const GridSearch &search, uint32_t tile) { return (search.closed[tile / 64] >> (tile % 64)) & 1; }
+  inline void close_tile(GridSearch &search, uint32_t tile) { search.closed[tile / 64] |= uint64_t(1) << (tile % 64); }
+
+  // Called for every expanded tile with its g, handy for debug drawing.
+  using ExpandCallback = std::function<void(size_t tile, float g)>;
+
+  // 4-connected A* over tiles inside `limits`, f = g + weight * euclidean distance.
+  // Returns tile indices from `from` to `to` inclusive, empty if there's no path.
+  std::vector<size_t> find_grid_path(const GridMap &map, GridPos from, GridPos to, const GridRect &limits, float weight = 1.f,
+                                     const ExpandCallback &on_expand = nullptr);
+};
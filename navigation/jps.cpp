@@ -0,0 +1,311 @@
+#include "jps.h"
+#include "gridComponents.h"
+#include <algorithm>
+#include <bit>
+#include <cstdlib>
+
+namespace
+{
+  struct JpsQuery
+  {
+    const nav::JpsGrid &grid;
+    const nav::GridRect &limits;
+    nav::GridPos to;
+  };
+};
+
+static bool is_blocked(const JpsQuery &q, int x, int y)
+{
+  if (x < q.limits.minX || y < q.limits.minY || x >= q.limits.maxX || y >= q.limits.maxY)
+    return true;
+  return (q.grid.blocked[size_t(y) * q.grid.rowWords + size_t(x) / 64] >> (size_t(x) % 64)) & 1;
+}
+
+// Word `w` of row `y` with tiles outside of limits set as blocked.
+static uint64_t get_blocked_word(const JpsQuery &q, int y, size_t w)
+{
+  if (y < q.limits.minY || y >= q.limits.maxY)
+    return ~uint64_t(0);
+  uint64_t word = q.grid.blocked[size_t(y) * q.grid.rowWords + w];
+  const int first = int(w * 64);
+  if (q.limits.minX > first)
+    word |= q.limits.minX - first >= 64 ? ~uint64_t(0) : (uint64_t(1) << (q.limits.minX - first)) - 1;
+  if (q.limits.maxX < first + 64)
+    word |= q.limits.maxX <= first ? ~uint64_t(0) : ~uint64_t(0) << (q.limits.maxX - first);
+  return word;
+}
+
+static uint64_t get_forced_bits(uint64_t side, uint64_t side_behind)
+{
+  return ~side & side_behind; // side tile is open while the one we came past is a wall
+}
+
+// Scans row `y` from `x` (exclusive) a word at a time. Returns x of the first forced neighbour or the goal,
+// -1 if a wall comes first.
+static int scan_right(const JpsQuery &q, int x, int y)
+{
+  const int start = x + 1;
+  if (start >= q.limits.maxX)
+    return -1;
+  for (size_t w = size_t(start) / 64; w < q.grid.rowWords; ++w)
+  {
+    const uint64_t cur = get_blocked_word(q, y, w);
+    const uint64_t up = get_blocked_word(q, y - 1, w);
+    const uint64_t down = get_blocked_word(q, y + 1, w);
+    // bit i holds the tile at x - 1
+    const uint64_t upBehind = (up << 1) | (w > 0 ? get_blocked_word(q, y - 1, w - 1) >> 63 : 1);
+    const uint64_t downBehind = (down << 1) | (w > 0 ? get_blocked_word(q, y + 1, w - 1) >> 63 : 1);
+    uint64_t stop = cur | get_forced_bits(up, upBehind) | get_forced_bits(down, downBehind);
+    if (y == q.to.y && q.to.x >= int(w * 64) && q.to.x < int(w * 64 + 64))
+      stop |= uint64_t(1) << (q.to.x - int(w * 64));
+    if (w == size_t(start) / 64)
+      stop &= ~uint64_t(0) << (start % 64);
+    if (!stop)
+      continue;
+    const int res = int(w * 64) + std::countr_zero(stop);
+    return (cur >> (res % 64)) & 1 ? -1 : res;
+  }
+  return -1;
+}
+
+static int scan_left(const JpsQuery &q, int x, int y)
+{
+  const int start = x - 1;
+  if (start < q.limits.minX)
+    return -1;
+  for (size_t w = size_t(start) / 64 + 1; w-- > 0;)
+  {
+    const uint64_t cur = get_blocked_word(q, y, w);
+    const uint64_t up = get_blocked_word(q, y - 1, w);
+    const uint64_t down = get_blocked_word(q, y + 1, w);
+    // bit i holds the tile at x + 1
+    const bool hasNext = w + 1 < q.grid.rowWords;
+    const uint64_t upBehind = (up >> 1) | ((hasNext ? get_blocked_word(q, y - 1, w + 1) : 1) << 63);
+    const uint64_t downBehind = (down >> 1) | ((hasNext ? get_blocked_word(q, y + 1, w + 1) : 1) << 63);
+    uint64_t stop = cur | get_forced_bits(up, upBehind) | get_forced_bits(down, downBehind);
+    if (y == q.to.y && q.to.x >= int(w * 64) && q.to.x < int(w * 64 + 64))
+      stop |= uint64_t(1) << (q.to.x - int(w * 64));
+    if (w == size_t(start) / 64 && start % 64 != 63)
+      stop &= (uint64_t(1) << (start % 64 + 1)) - 1;
+    if (!stop)
+      continue;
+    const int res = int(w * 64) + 63 - std::countl_zero(stop);
+    return (cur >> (res % 64)) & 1 ? -1 : res;
+  }
+  return -1;
+}
+
+// Returns y of the jump point, -1 if the run hits a wall.
+static int scan_vertical(const JpsQuery &q, int x, int y, int dy)
+{
+  for (y += dy; !is_blocked(q, x, y); y += dy)
+    if ((x == q.to.x && y == q.to.y) || scan_right(q, x, y) >= 0 || scan_left(q, x, y) >= 0)
+      return y;
+  return -1;
+}
+
+static int32_t get_jump_dist(const nav::JpsGrid &grid, int x, int y, nav::JumpDir dir)
+{
+  return grid.jumpDist[size_t(y) * grid.width + size_t(x)][dir];
+}
+
+// JPS+ version of the scans: the goal is the only thing not baked into the table.
+static int jump_precomputed(const JpsQuery &q, int x, int y, nav::JumpDir dir)
+{
+  const int dist = get_jump_dist(q.grid, x, y, dir);
+  const int steps = std::abs(dist);
+  switch (dir)
+  {
+    case nav::JD_RIGHT:
+      if (y == q.to.y && q.to.x > x && q.to.x - x <= steps)
+        return q.to.x;
+      return dist > 0 ? x + dist : -1;
+    case nav::JD_LEFT:
+      if (y == q.to.y && q.to.x < x && x - q.to.x <= steps)
+        return q.to.x;
+      return dist > 0 ? x - dist : -1;
+    case nav::JD_DOWN:
+      // stopping at the goal row lets the horizontal jumps from there reach it
+      if (q.to.y > y && q.to.y - y <= steps)
+        return q.to.y;
+      return dist > 0 ? y + dist : -1;
+    case nav::JD_UP:
+      if (q.to.y < y && y - q.to.y <= steps)
+        return q.to.y;
+      return dist > 0 ? y - dist : -1;
+    default:
+      return -1;
+  }
+}
+
+nav::JpsGrid nav::build_jps_grid(const GridMap &map, bool precompute_jumps)
+{
+  JpsGrid grid;
+  grid.width = map.width;
+  grid.height = map.height;
+  grid.rowWords = (map.width + 63) / 64;
+  grid.blocked.assign(grid.rowWords * map.height, ~uint64_t(0));
+  float walkableCost = -1.f;
+  for (size_t y = 0; y < map.height; ++y)
+    for (size_t x = 0; x < map.width; ++x)
+    {
+      const float cost = get_tile_cost(map, y * map.width + x);
+      if (cost == blocked_tile)
+        continue;
+      grid.blocked[y * grid.rowWords + x / 64] &= ~(uint64_t(1) << (x % 64));
+      if (walkableCost < 0.f)
+        walkableCost = cost;
+      grid.uniformCost &= cost == walkableCost;
+    }
+  grid.stepCost = walkableCost < 0.f ? 1.f : walkableCost;
+  if (!precompute_jumps || !grid.uniformCost)
+    return grid;
+
+  const GridRect all{0, 0, int(map.width), int(map.height)};
+  const JpsQuery q{grid, all, {-1, -1}};
+  auto isWall = [&](int x, int y) { return is_blocked(q, x, y); };
+  auto isForced = [&](int x, int y, int dx)
+  {
+    return (!isWall(x, y - 1) && isWall(x - dx, y - 1)) || (!isWall(x, y + 1) && isWall(x - dx, y + 1));
+  };
+  // distance to the next jump point is one more than the neighbour's, or it's a jump point itself
+  auto chain = [](bool wall, bool jump_point, int32_t next) -> int32_t
+  {
+    return wall ? 0 : jump_point ? 1 : next > 0 ? next + 1 : next - 1;
+  };
+  grid.jumpDist.assign(map.width * map.height, {});
+  const int w = int(map.width);
+  const int h = int(map.height);
+  for (int y = 0; y < h; ++y)
+  {
+    for (int x = w - 1; x >= 0; --x)
+      grid.jumpDist[size_t(y * w + x)][JD_RIGHT] =
+        chain(isWall(x + 1, y), isForced(x + 1, y, 1), x + 1 < w ? get_jump_dist(grid, x + 1, y, JD_RIGHT) : 0);
+    for (int x = 0; x < w; ++x)
+      grid.jumpDist[size_t(y * w + x)][JD_LEFT] =
+        chain(isWall(x - 1, y), isForced(x - 1, y, -1), x > 0 ? get_jump_dist(grid, x - 1, y, JD_LEFT) : 0);
+  }
+  auto hasHorizontalJump = [&](int x, int y)
+  {
+    return get_jump_dist(grid, x, y, JD_RIGHT) > 0 || get_jump_dist(grid, x, y, JD_LEFT) > 0;
+  };
+  for (int x = 0; x < w; ++x)
+  {
+    for (int y = h - 1; y >= 0; --y)
+      grid.jumpDist[size_t(y * w + x)][JD_DOWN] = isWall(x, y + 1) ? 0 :
+        chain(false, hasHorizontalJump(x, y + 1), get_jump_dist(grid, x, y + 1, JD_DOWN));
+    for (int y = 0; y < h; ++y)
+      grid.jumpDist[size_t(y * w + x)][JD_UP] = isWall(x, y - 1) ? 0 :
+        chain(false, hasHorizontalJump(x, y - 1), get_jump_dist(grid, x, y - 1, JD_UP));
+  }
+  return grid;
+}
+
+std::vector<size_t> nav::find_jps_path(const JpsGrid &grid, const GridMap &map, GridPos from, GridPos to, const GridRect &limits,
+                                       const ExpandCallback &on_expand)
+{
+  if (!grid.uniformCost)
+    return find_grid_path(map, from, to, limits, 1.f, on_expand);
+  if (from.x < 0 || from.y < 0 || from.x >= int(map.width) || from.y >= int(map.height))
+    return {};
+  const bool toInside = to.x >= 0 && to.y >= 0 && to.x < int(map.width) && to.y < int(map.height);
+  if (!toInside || is_goal_cut_off(map, from, to))
+    return {};
+  const bool usePrecomputed = !grid.jumpDist.empty() &&
+    limits.minX <= 0 && limits.minY <= 0 && limits.maxX >= int(map.width) && limits.maxY >= int(map.height);
+  const JpsQuery q{grid, limits, to};
+
+  thread_local GridSearch search;
+  begin_grid_search(search, map.width * map.height);
+  auto toTile = [&](int x, int y) { return uint32_t(size_t(y) * map.width + size_t(x)); };
+  auto heuristic = [&](int x, int y) { return grid.stepCost * float(std::abs(x - to.x) + std::abs(y - to.y)); };
+  const uint32_t fromTile = toTile(from.x, from.y);
+  const uint32_t goalTile = toTile(to.x, to.y);
+  touch_tile(search, fromTile);
+  search.g[fromTile] = 0.f;
+  push_open_tile(search.open, fromTile, heuristic(from.x, from.y));
+  while (!is_open_heap_empty(search.open))
+  {
+    const uint32_t cur = pop_open_tile(search.open);
+    if (cur == goalTile)
+    {
+      // jump points are on straight lines from each other, fill the tiles in between
+      std::vector<size_t> path = {goalTile};
+      for (uint32_t tile = goalTile; search.parent[tile] != invalid_tile; tile = search.parent[tile])
+      {
+        const int px = int(search.parent[tile] % map.width);
+        const int py = int(search.parent[tile] / map.width);
+        int x = int(tile % map.width);
+        int y = int(tile / map.width);
+        const int dx = px > x ? 1 : px < x ? -1 : 0;
+        const int dy = py > y ? 1 : py < y ? -1 : 0;
+        while (x != px || y != py)
+        {
+          x += dx;
+          y += dy;
+          path.push_back(toTile(x, y));
+        }
+      }
+      std::reverse(path.begin(), path.end());
+      return path;
+    }
+    close_tile(search, cur);
+    const float curG = search.g[cur];
+    if (on_expand)
+      on_expand(cur, curG);
+    const int x = int(cur % map.width);
+    const int y = int(cur / map.width);
+    auto addJumpPoint = [&](int jx, int jy)
+    {
+      const uint32_t tile = toTile(jx, jy);
+      touch_tile(search, tile);
+      const float gScore = curG + grid.stepCost * float(std::abs(jx - x) + std::abs(jy - y));
+      if (gScore >= search.g[tile])
+        return;
+      search.g[tile] = gScore;
+      search.parent[tile] = cur;
+      if (!is_tile_closed(search, tile))
+        push_open_tile(search.open, tile, gScore + heuristic(jx, jy));
+    };
+    auto jump = [&](JumpDir dir)
+    {
+      const bool horizontal = dir == JD_RIGHT || dir == JD_LEFT;
+      int res = -1;
+      if (usePrecomputed)
+        res = jump_precomputed(q, x, y, dir);
+      else if (horizontal)
+        res = dir == JD_RIGHT ? scan_right(q, x, y) : scan_left(q, x, y);
+      else
+        res = scan_vertical(q, x, y, dir == JD_DOWN ? 1 : -1);
+      if (res >= 0)
+        addJumpPoint(horizontal ? res : x, horizontal ? y : res);
+    };
+
+    const uint32_t parent = search.parent[cur];
+    const int px = parent == invalid_tile ? x : int(parent % map.width);
+    const int py = parent == invalid_tile ? y : int(parent / map.width);
+    if (parent == invalid_tile)
+    {
+      jump(JD_RIGHT);
+      jump(JD_LEFT);
+      jump(JD_DOWN);
+      jump(JD_UP);
+    }
+    else if (py == y) // horizontal run, turns only into forced neighbours
+    {
+      const int dx = x > px ? 1 : -1;
+      jump(dx > 0 ? JD_RIGHT : JD_LEFT);
+      if (!is_blocked(q, x, y + 1) && is_blocked(q, x - dx, y + 1))
+        jump(JD_DOWN);
+      if (!is_blocked(q, x, y - 1) && is_blocked(q, x - dx, y - 1))
+        jump(JD_UP);
+    }
+    else // vertical run, both horizontal turns are natural
+    {
+      jump(JD_RIGHT);
+      jump(JD_LEFT);
+      jump(y > py ? JD_DOWN : JD_UP);
+    }
+  }
+  return {};
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "gridSearch.h"
+
+// Jump point search for 4-connected grids. Canonical paths go vertically first, so a horizontal run
+// only branches where a wall behind it opens a side passage (forced neighbour) and a vertical run stops
+// wherever a horizontal jump from it would find something. Only valid while all walkable tiles cost the same.
+namespace nav
+{
+  enum JumpDir
+  {
+    JD_RIGHT,
+    JD_LEFT,
+    JD_DOWN,
+    JD_UP,
+    JD_NUM
+  };
+
+  struct JpsGrid
+  {
+    size_t width = 0;
+    size_t height = 0;
+    size_t rowWords = 0;
+    std::vector<uint64_t> blocked; // rowWords per row, bits past the width are set
+    bool uniformCost = true;
+    float stepCost = 1.f;
+    // JPS+: per tile and direction, > 0 - distance to the next jump point, <= 0 - steps until a wall
+    std::vector<std::array<int32_t, JD_NUM>> jumpDist;
+  };
+
+  // Snapshot of the map walls, has to be rebuilt when tiles change.
+  JpsGrid build_jps_grid(const GridMap &map, bool precompute_jumps);
+
+  // Same interface as find_grid_path (weight is always 1). Falls back to it if the grid has weighted tiles,
+  // precomputed jump distances are used only when limits cover the whole map.
+  std::vector<size_t> find_jps_path(const JpsGrid &grid, const GridMap &map, GridPos from, GridPos to, const GridRect &limits,
+                                    const ExpandCallback &on_expand = nullptr);
+};
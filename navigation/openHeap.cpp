@@ -0,0 +1,76 @@
+#include "openHeap.h"
+
+static bool is_less(const nav::OpenEntry &lhs, const nav::OpenEntry &rhs)
+{
+  return lhs.f < rhs.f || (lhs.f == rhs.f && lhs.seq < rhs.seq);
+}
+
+static void sift_up(nav::OpenHeap &heap, size_t pos)
+{
+  const nav::OpenEntry entry = heap.entries[pos];
+  while (pos > 0)
+  {
+    const size_t parent = (pos - 1) / 2;
+    if (!is_less(entry, heap.entries[parent]))
+      break;
+    heap.entries[pos] = heap.entries[parent];
+    heap.heapPos[heap.entries[pos].tile] = uint32_t(pos);
+    pos = parent;
+  }
+  heap.entries[pos] = entry;
+  heap.heapPos[entry.tile] = uint32_t(pos);
+}
+
+static void sift_down(nav::OpenHeap &heap, size_t pos)
+{
+  const nav::OpenEntry entry = heap.entries[pos];
+  const size_t size = heap.entries.size();
+  while (true)
+  {
+    size_t child = pos * 2 + 1;
+    if (child >= size)
+      break;
+    if (child + 1 < size && is_less(heap.entries[child + 1], heap.entries[child]))
+      child++;
+    if (!is_less(heap.entries[child], entry))
+      break;
+    heap.entries[pos] = heap.entries[child];
+    heap.heapPos[heap.entries[pos].tile] = uint32_t(pos);
+    pos = child;
+  }
+  heap.entries[pos] = entry;
+  heap.heapPos[entry.tile] = uint32_t(pos);
+}
+
+void nav::reset_open_heap(OpenHeap &heap, size_t num_tiles)
+{
+  for (const OpenEntry &entry : heap.entries)
+    heap.heapPos[entry.tile] = invalid_tile;
+  heap.entries.clear();
+  heap.heapPos.resize(num_tiles, invalid_tile);
+  heap.nextSeq = 0;
+}
+
+void nav::push_open_tile(OpenHeap &heap, uint32_t tile, float f)
+{
+  const uint32_t pos = heap.heapPos[tile];
+  if (pos != invalid_tile)
+  {
+    heap.entries[pos].f = f;
+    sift_up(heap, pos);
+    return;
+  }
+  heap.entries.push_back({f, heap.nextSeq++, tile});
+  sift_up(heap, heap.entries.size() - 1);
+}
+
+uint32_t nav::pop_open_tile(OpenHeap &heap)
+{
+  const uint32_t tile = heap.entries.front().tile;
+  heap.heapPos[tile] = invalid_tile;
+  heap.entries.front() = heap.entries.back();
+  heap.entries.pop_back();
+  if (!heap.entries.empty())
+    sift_down(heap, 0);
+  return tile;
+}
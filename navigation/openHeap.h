@@ -0,0 +1,33 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace nav
+{
+  constexpr uint32_t invalid_tile = uint32_t(-1);
+
+  struct OpenEntry
+  {
+    float f;
+    uint32_t seq; // order of the first push, ties go to the tile which was opened first
+    uint32_t tile;
+  };
+
+  // Binary min-heap of tiles ordered by (f, seq). Heap position of every tile is tracked,
+  // so a tile is never duplicated and its f is decreased in place.
+  struct OpenHeap
+  {
+    std::vector<OpenEntry> entries;
+    std::vector<uint32_t> heapPos; // per tile, invalid_tile if it's not in the heap
+    uint32_t nextSeq = 0;
+  };
+
+  // Only tiles left in the heap are touched, so resetting after a small search is cheap.
+  void reset_open_heap(OpenHeap &heap, size_t num_tiles);
+  inline bool is_open_heap_empty(const OpenHeap &heap) { return heap.entries.empty(); }
+  inline bool is_in_open_heap(const OpenHeap &heap, uint32_t tile) { return heap.heapPos[tile] != invalid_tile; }
+  // Adds the tile or lowers its f if it's already there (f is expected not to grow).
+  void push_open_tile(OpenHeap &heap, uint32_t tile, float f);
+  uint32_t pop_open_tile(OpenHeap &heap);
+};
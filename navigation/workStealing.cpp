@@ -0,0 +1,78 @@
+#include "workStealing.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// Range is packed into one word, so the owner taking from the front and thieves cutting the back
+// are both a single compare-exchange.
+static uint64_t pack_range(uint32_t begin, uint32_t end) { return (uint64_t(begin) << 32) | end; }
+static uint32_t range_begin(uint64_t range) { return uint32_t(range >> 32); }
+static uint32_t range_end(uint64_t range) { return uint32_t(range); }
+
+void nav::parallel_for(size_t count, size_t num_threads, const std::function<void(size_t)> &task)
+{
+  if (num_threads == 0)
+    num_threads = std::max(size_t(std::thread::hardware_concurrency()), size_t(1));
+  num_threads = std::min(num_threads, count);
+  if (num_threads <= 1)
+  {
+    for (size_t i = 0; i < count; ++i)
+      task(i);
+    return;
+  }
+
+  std::unique_ptr<std::atomic<uint64_t>[]> ranges(new std::atomic<uint64_t>[num_threads]);
+  for (size_t t = 0; t < num_threads; ++t)
+    ranges[t] = pack_range(uint32_t(count * t / num_threads), uint32_t(count * (t + 1) / num_threads));
+
+  auto worker = [&](size_t self)
+  {
+    while (true)
+    {
+      uint64_t range = ranges[self].load();
+      while (range_begin(range) < range_end(range))
+      {
+        if (!ranges[self].compare_exchange_weak(range, pack_range(range_begin(range) + 1, range_end(range))))
+          continue;
+        task(range_begin(range));
+        range = ranges[self].load();
+      }
+      // out of work, take the back half of the fullest range
+      bool stolen = false;
+      while (!stolen)
+      {
+        size_t victim = num_threads;
+        uint32_t victimSize = 0;
+        for (size_t t = 0; t < num_threads; ++t)
+        {
+          const uint64_t r = ranges[t].load();
+          if (range_end(r) > range_begin(r) && range_end(r) - range_begin(r) > victimSize)
+          {
+            victim = t;
+            victimSize = range_end(r) - range_begin(r);
+          }
+        }
+        if (victim == num_threads)
+          return;
+        uint64_t r = ranges[victim].load();
+        if (range_begin(r) >= range_end(r))
+          continue;
+        const uint32_t mid = range_begin(r) + (range_end(r) - range_begin(r)) / 2;
+        if (ranges[victim].compare_exchange_strong(r, pack_range(range_begin(r), mid)))
+        {
+          ranges[self] = pack_range(mid, range_end(r));
+          stolen = true;
+        }
+      }
+    }
+  };
+  std::vector<std::thread> workers;
+  for (size_t t = 1; t < num_threads; ++t)
+    workers.emplace_back(worker, t);
+  worker(0);
+  for (std::thread &t : workers)
+    t.join();
+}
@@ -0,0 +1,11 @@
+#pragma once
+#include <cstddef>
+#include <functional>
+
+namespace nav
+{
+  // Runs task(i) for every i in [0, count). Each thread starts with its own contiguous range and, once it's done,
+  // steals the back half of the biggest range left, so uneven tasks still keep all threads busy.
+  // num_threads == 0 uses all hardware threads, the calling thread is one of the workers.
+  void parallel_for(size_t count, size_t num_threads, const std::function<void(size_t)> &task);
+};
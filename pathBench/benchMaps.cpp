@@ -0,0 +1,119 @@
+#include "benchMaps.h"
+#include <algorithm>
+#include <cstdlib>
+#include <random>
+
+constexpr char wall = '#';
+constexpr char floor_tile = ' ';
+constexpr char water = 'o';
+
+static nav::GridPos find_walkable(const BenchMap &map, std::mt19937 &rng)
+{
+  while (true)
+  {
+    const size_t x = rng() % map.width;
+    const size_t y = rng() % map.height;
+    if (map.tiles[y * map.width + x] != wall)
+      return {int(x), int(y)};
+  }
+}
+
+BenchMap gen_bench_drunk_dungeon(size_t width, size_t height, size_t num_iter, size_t max_excavations, uint32_t seed)
+{
+  BenchMap map;
+  map.name = "drunk " + std::to_string(width) + "x" + std::to_string(height);
+  map.width = width;
+  map.height = height;
+  map.tiles.assign(width * height, wall);
+  std::mt19937 rng(seed);
+  const int dirs[4][2] = {{1, 0}, {0, 1}, {-1, 0}, {0, -1}};
+
+  std::vector<nav::GridPos> startPos;
+  for (size_t iter = 0; iter < num_iter; ++iter)
+  {
+    int x = 1 + int(rng() % (width - 2));
+    int y = 1 + int(rng() % (height - 2));
+    startPos.push_back({x, y});
+    size_t numExcavations = 0;
+    while (numExcavations < max_excavations)
+    {
+      char &tile = map.tiles[size_t(y) * width + size_t(x)];
+      if (tile == wall)
+      {
+        numExcavations++;
+        tile = floor_tile;
+      }
+      const size_t dir = rng() % 4;
+      x = std::clamp(x + dirs[dir][0], 1, int(width) - 2);
+      y = std::clamp(y + dirs[dir][1], 1, int(height) - 2);
+    }
+  }
+
+  // corridors between closest start positions, so most of the map is connected
+  for (size_t i = 0; i + 1 < startPos.size(); ++i)
+  {
+    nav::GridPos pos = startPos[i];
+    nav::GridPos closestPos = startPos[i + 1];
+    int closestDistSq = INT32_MAX;
+    for (size_t j = i + 1; j < startPos.size(); ++j)
+    {
+      const int dx = startPos[j].x - pos.x;
+      const int dy = startPos[j].y - pos.y;
+      if (dx * dx + dy * dy < closestDistSq)
+      {
+        closestDistSq = dx * dx + dy * dy;
+        closestPos = startPos[j];
+      }
+    }
+    while (pos.x != closestPos.x || pos.y != closestPos.y)
+    {
+      const int dx = closestPos.x - pos.x;
+      const int dy = closestPos.y - pos.y;
+      if (abs(dx) > abs(dy))
+        pos.x += dx > 0 ? 1 : -1;
+      else
+        pos.y += dy > 0 ? 1 : -1;
+      map.tiles[size_t(pos.y) * width + size_t(pos.x)] = floor_tile;
+    }
+  }
+  return map;
+}
+
+void spill_bench_water(BenchMap &map, size_t num_iter, size_t max_spills, uint32_t seed)
+{
+  map.name += " + water";
+  std::mt19937 rng(seed);
+  const int dirs[4][2] = {{1, 0}, {0, 1}, {-1, 0}, {0, -1}};
+  for (size_t iter = 0; iter < num_iter; ++iter)
+  {
+    nav::GridPos pos = find_walkable(map, rng);
+    size_t numSpills = 0;
+    // drunk walk over walkable tiles, gives up on tiny pockets instead of looping forever
+    for (size_t step = 0; numSpills < max_spills && step < max_spills * 100; ++step)
+    {
+      char &tile = map.tiles[size_t(pos.y) * map.width + size_t(pos.x)];
+      if (tile == floor_tile)
+      {
+        numSpills++;
+        tile = water;
+      }
+      const size_t dir = rng() % 4;
+      const int nx = std::clamp(pos.x + dirs[dir][0], 1, int(map.width) - 2);
+      const int ny = std::clamp(pos.y + dirs[dir][1], 1, int(map.height) - 2);
+      if (map.tiles[size_t(ny) * map.width + size_t(nx)] != wall)
+        pos = {nx, ny};
+    }
+  }
+}
+
+std::vector<std::pair<nav::GridPos, nav::GridPos>> gen_bench_queries(const BenchMap &map, size_t count, uint32_t seed)
+{
+  std::mt19937 rng(seed);
+  std::vector<std::pair<nav::GridPos, nav::GridPos>> res;
+  for (size_t i = 0; i < count; ++i)
+  {
+    const nav::GridPos from = find_walkable(map, rng);
+    res.push_back({from, find_walkable(map, rng)});
+  }
+  return res;
+}
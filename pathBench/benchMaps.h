@@ -0,0 +1,21 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "gridSearch.h"
+
+struct BenchMap
+{
+  std::string name;
+  std::vector<char> tiles;
+  size_t width = 0;
+  size_t height = 0;
+};
+
+// Seeded copies of the drunk dungeon generators from pathfinding/ (those use raylib's random and print the map).
+BenchMap gen_bench_drunk_dungeon(size_t width, size_t height, size_t num_iter, size_t max_excavations, uint32_t seed);
+void spill_bench_water(BenchMap &map, size_t num_iter, size_t max_spills, uint32_t seed);
+
+// Random pairs of walkable tiles, not necessarily connected to each other.
+std::vector<std::pair<nav::GridPos, nav::GridPos>> gen_bench_queries(const BenchMap &map, size_t count, uint32_t seed);
@@ -0,0 +1,99 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <vector>
+
+#include "gridSearch.h"
+#include "jps.h"
+#include "benchMaps.h"
+
+using BenchClock = std::chrono::steady_clock;
+using BenchQueries = std::vector<std::pair<nav::GridPos, nav::GridPos>>;
+using PathFunc = std::function<std::vector<size_t>(nav::GridPos from, nav::GridPos to, const nav::ExpandCallback &on_expand)>;
+
+struct QueryResult
+{
+  float cost = 0.f;
+  size_t numExpanded = 0;
+};
+
+static float get_path_cost(const nav::GridMap &map, const std::vector<size_t> &path)
+{
+  float cost = 0.f;
+  for (size_t i = 1; i < path.size(); ++i)
+    cost += nav::get_tile_cost(map, path[i]);
+  return cost;
+}
+
+static std::vector<QueryResult> run_path_func(const char *name, const nav::GridMap &map, const BenchQueries &queries,
+                                              const PathFunc &path_func, const std::vector<QueryResult> *reference)
+{
+  std::vector<QueryResult> results;
+  size_t numExpanded = 0;
+  for (const auto &[from, to] : queries)
+  {
+    QueryResult res;
+    res.cost = get_path_cost(map, path_func(from, to, [&](size_t, float) { res.numExpanded++; }));
+    numExpanded += res.numExpanded;
+    results.push_back(res);
+  }
+  size_t numMismatches = 0;
+  for (size_t i = 0; reference && i < results.size(); ++i)
+    numMismatches += results[i].cost != (*reference)[i].cost;
+
+  const BenchClock::time_point start = BenchClock::now();
+  for (const auto &[from, to] : queries)
+    path_func(from, to, nullptr);
+  const std::chrono::duration<double, std::micro> elapsed = BenchClock::now() - start;
+  printf("  %-8s %10.1f us/query %10.1f nodes/query  %s\n", name, elapsed.count() / double(queries.size()),
+         double(numExpanded) / double(queries.size()), numMismatches ? "MISMATCH" : "ok");
+  return results;
+}
+
+static void run_bench_map(const BenchMap &bench, const nav::TileCosts &costs, size_t num_queries, uint32_t seed)
+{
+  const nav::GridMap map{bench.tiles.data(), bench.width, bench.height, &costs};
+  const nav::GridRect limits{0, 0, int(bench.width), int(bench.height)};
+  const BenchQueries queries = gen_bench_queries(bench, num_queries, seed);
+
+  const BenchClock::time_point buildStart = BenchClock::now();
+  const nav::JpsGrid jpsGrid = nav::build_jps_grid(map, false);
+  const BenchClock::time_point jumpsStart = BenchClock::now();
+  const nav::JpsGrid jpsPlusGrid = nav::build_jps_grid(map, true);
+  const std::chrono::duration<double, std::milli> buildTime = jumpsStart - buildStart;
+  const std::chrono::duration<double, std::milli> jumpsTime = BenchClock::now() - jumpsStart;
+  printf("%s: %zu queries, jps grid %.2f ms, jps+ grid %.2f ms%s\n", bench.name.c_str(), queries.size(), buildTime.count(),
+         jumpsTime.count(), jpsGrid.uniformCost ? "" : " (weighted tiles, jps falls back to a*)");
+
+  const std::vector<QueryResult> reference = run_path_func("a*", map, queries,
+    [&](nav::GridPos from, nav::GridPos to, const nav::ExpandCallback &on_expand)
+    {
+      return nav::find_grid_path(map, from, to, limits, 1.f, on_expand);
+    }, nullptr);
+  run_path_func("jps", map, queries, [&](nav::GridPos from, nav::GridPos to, const nav::ExpandCallback &on_expand)
+  {
+    return nav::find_jps_path(jpsGrid, map, from, to, limits, on_expand);
+  }, &reference);
+  run_path_func("jps+", map, queries, [&](nav::GridPos from, nav::GridPos to, const nav::ExpandCallback &on_expand)
+  {
+    return nav::find_jps_path(jpsPlusGrid, map, from, to, limits, on_expand);
+  }, &reference);
+}
+
+// usage: path_bench [seed] [queries per map]
+int main(int argc, const char **argv)
+{
+  const uint32_t seed = argc > 1 ? uint32_t(strtoul(argv[1], nullptr, 10)) : 0;
+  const size_t numQueries = argc > 2 ? strtoul(argv[2], nullptr, 10) : 200;
+
+  const nav::TileCosts costs = nav::make_tile_costs({{'#', nav::blocked_tile}, {'o', 10.f}});
+  // same parameters as the pathfinding sandbox, then bigger maps with proportionally more diggers
+  run_bench_map(gen_bench_drunk_dungeon(100, 100, 24, 100, seed), costs, numQueries, seed);
+  run_bench_map(gen_bench_drunk_dungeon(512, 512, 600, 100, seed), costs, numQueries, seed);
+  run_bench_map(gen_bench_drunk_dungeon(1024, 1024, 2400, 100, seed), costs, numQueries, seed);
+  BenchMap watered = gen_bench_drunk_dungeon(512, 512, 600, 100, seed);
+  spill_bench_water(watered, 200, 10, seed);
+  run_bench_map(watered, costs, numQueries, seed);
+  return 0;
+}
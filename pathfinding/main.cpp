@@ -1,4 +1,5 @@
 #include "raylib.h"
+#include <chrono>
 #include <functional>
 #include <vector>
 #include <limits>
@@ -7,6 +8,10 @@
 #include "math.h"
 #include "dungeonGen.h"
 #include "dungeonUtils.h"
+#include "gridSearch.h"
+#include "gridComponents.h"
+#include "dstarLite.h"
+#include "araStar.h"
 
 template<typename T>
 static size_t coord_to_idx(T x, T y, size_t w)
@@ -36,16 +41,13 @@ static void draw_path(std::vector<Position> path)
   }
 }
 
-static std::vector<Position> reconstruct_path(std::vector<Position> prev, Position to, size_t width)
+static const nav::TileCosts tile_costs = nav::make_tile_costs({{dungeon::wall, nav::blocked_tile}, {dungeon::water, 10.f}});
+// rebuilt with the map and updated on tile edits, searches towards sealed off tiles are skipped
+static nav::GridComponents components;
+
+static nav::GridMap make_nav_map(const char *input, size_t width, size_t height)
 {
-  Position curPos = to;
-  std::vector<Position> res = {curPos};
-  while (prev[coord_to_idx(curPos.x, curPos.y, width)] != Position{-1, -1})
-  {
-    curPos = prev[coord_to_idx(curPos.x, curPos.y, width)];
-    res.insert(res.begin(), curPos);
-  }
-  return res;
+  return {input, width, height, &tile_costs, &components};
 }
 
 float heuristic(Position lhs, Position rhs)
@@ -97,6 +99,8 @@ static float ida_star_search(const char *input, size_t width, size_t height, std
 
 static std::vector<Position> find_ida_star_path(const char *input, size_t width, size_t height, Position from, Position to)
 {
+  if (nav::is_goal_cut_off(make_nav_map(input, width, height), {from.x, from.y}, {to.x, to.y}))
+    return {};
   float bound = heuristic(from, to);
   std::vector<Position> path = {from};
   while (true)
@@ -112,179 +116,38 @@ static std::vector<Position> find_ida_star_path(const char *input, size_t width,
   return {};
 }
 
-static std::vector<Position> find_path_a_star(const char *input, size_t width, size_t height, Position from, Position to, float weight)
+static std::vector<Position> tiles_to_path(const std::vector<size_t> &tiles, size_t width)
 {
-  if (from.x < 0 || from.y < 0 || from.x >= int(width) || from.y >= int(height))
-    return std::vector<Position>();
-  size_t inpSize = width * height;
-
-  std::vector<float> g(inpSize, std::numeric_limits<float>::max());
-  std::vector<float> f(inpSize, std::numeric_limits<float>::max());
-  std::vector<Position> prev(inpSize, {-1,-1});
-
-  auto getG = [&](Position p) -> float { return g[coord_to_idx(p.x, p.y, width)]; };
-  auto getF = [&](Position p) -> float { return f[coord_to_idx(p.x, p.y, width)]; };
-
-  g[coord_to_idx(from.x, from.y, width)] = 0;
-  f[coord_to_idx(from.x, from.y, width)] = weight * heuristic(from, to);
-
-  std::vector<Position> openList = {from};
-  std::vector<Position> closedList;
-
-  while (!openList.empty())
-  {
-    size_t bestIdx = 0;
-    float bestScore = getF(openList[0]);
-    for (size_t i = 1; i < openList.size(); ++i)
-    {
-      float score = getF(openList[i]);
-      if (score < bestScore)
-      {
-        bestIdx = i;
-        bestScore = score;
-      }
-    }
-    if (openList[bestIdx] == to)
-      return reconstruct_path(prev, to, width);
-    Position curPos = openList[bestIdx];
-    openList.erase(openList.begin() + bestIdx);
-    if (std::find(closedList.begin(), closedList.end(), curPos) != closedList.end())
-      continue;
-    size_t idx = coord_to_idx(curPos.x, curPos.y, width);
-    const Rectangle rect = {float(curPos.x), float(curPos.y), 1.f, 1.f};
-    DrawRectangleRec(rect, Color{uint8_t(g[idx]), uint8_t(g[idx]), 0, 100});
-    closedList.emplace_back(curPos);
-    auto checkNeighbour = [&](Position p)
-    {
-      // out of bounds
-      if (p.x < 0 || p.y < 0 || p.x >= int(width) || p.y >= int(height))
-        return;
-      size_t idx = coord_to_idx(p.x, p.y, width);
-      // not empty
-      if (input[idx] == '#')
-        return;
-      float edgeWeight = input[idx] == 'o' ? 10.f : 1.f;
-      float gScore = getG(curPos) + 1.f * edgeWeight; // we're exactly 1 unit away
-      if (gScore < getG(p))
-      {
-        prev[idx] = curPos;
-        g[idx] = gScore;
-        f[idx] = gScore + weight * heuristic(p, to);
-      }
-      bool found = std::find(openList.begin(), openList.end(), p) != openList.end();
-      if (!found)
-        openList.emplace_back(p);
-    };
-    checkNeighbour({curPos.x + 1, curPos.y + 0});
-    checkNeighbour({curPos.x - 1, curPos.y + 0});
-    checkNeighbour({curPos.x + 0, curPos.y + 1});
-    checkNeighbour({curPos.x + 0, curPos.y - 1});
-  }
-  // empty path
-  return std::vector<Position>();
+  std::vector<Position> path;
+  path.reserve(tiles.size());
+  for (size_t tile : tiles)
+    path.push_back({int(tile % width), int(tile / width)});
+  return path;
 }
 
-static std::vector<Position> openList;
-static std::vector<float> g;
-std::vector<Position> prev;
-
-static float eps = 10;
-static int frames_until_iteration = 0;
-
-static std::vector<Position> find_path_ara_star(const char *input, size_t width, size_t height, Position from, Position to, float epsilon)
+static void draw_expanded_tile(size_t tile, float g, size_t width)
 {
-  if (from.x < 0 || from.y < 0 || from.x >= int(width) || from.y >= int(height))
-    return {};
-
-  auto getG = [&](Position p) -> float { return g[coord_to_idx(p.x, p.y, width)]; };
-  auto getF = [&](Position p) -> float { return getG(p) + epsilon * heuristic(p, to); };
-
-  g[coord_to_idx(from.x, from.y, width)] = 0;
-
-  std::vector<Position> closedList;
-  std::vector<Position> inconsList;
-
-  while (!openList.empty())
-  {
-    size_t bestIdx = 0;
-    float bestScore = getF(openList[0]);
-    for (size_t i = 1; i < openList.size(); ++i)
-    {
-      float score = getF(openList[i]);
-      if (score < bestScore)
-      {
-        bestIdx = i;
-        bestScore = score;
-      }
-    }
-
-    if (getF(to) > getF(openList[bestIdx]))
-    {
-      Position curPos = openList[bestIdx];
-      openList.erase(openList.begin() + bestIdx);
-      closedList.emplace_back(curPos);
-
-      size_t idx = coord_to_idx(curPos.x, curPos.y, width);
-      const Rectangle rect = { float(curPos.x), float(curPos.y), 1.f, 1.f };
-      DrawRectangleRec(rect, Color{ uint8_t(g[idx]), uint8_t(g[idx]), 0, 100 });
-
-      auto checkNeighbour = [&](Position p)
-      {
-        // out of bounds
-        if (p.x < 0 || p.y < 0 || p.x >= int(width) || p.y >= int(height))
-          return;
-        size_t idx = coord_to_idx(p.x, p.y, width);
-        // not empty
-        if (input[idx] == '#')
-          return;
-        float edgeWeight = input[idx] == 'o' ? 10.f : 1.f;
-        float gScore = getG(curPos) + 1.f * edgeWeight; // we're exactly 1 unit away
-        if (gScore < getG(p))
-        {
-          prev[idx] = curPos;
-          g[idx] = gScore;
-
-          if (std::find(closedList.begin(), closedList.end(), p) == closedList.end())
-          {
-            if (std::find(openList.begin(), openList.end(), p) == openList.end())
-              openList.emplace_back(p);
-          }
-          else
-          {
-            if (std::find(inconsList.begin(), inconsList.end(), p) == inconsList.end())
-              inconsList.emplace_back(p);
-          }
-        }
-      };
-      checkNeighbour({curPos.x + 1, curPos.y + 0});
-      checkNeighbour({curPos.x - 1, curPos.y + 0});
-      checkNeighbour({curPos.x + 0, curPos.y + 1});
-      checkNeighbour({curPos.x + 0, curPos.y - 1});
-    }
-    else
-    {
-      for (auto & i : inconsList)
-        if (std::find(openList.begin(), openList.end(), i) == openList.end())
-          openList.emplace_back(i);
-      inconsList.clear();
-      return reconstruct_path(prev, to, width);
-    }
-  }
-  return {};
+  const Rectangle rect = {float(tile % width), float(tile / width), 1.f, 1.f};
+  DrawRectangleRec(rect, Color{uint8_t(g), uint8_t(g), 0, 100});
 }
 
-static void reset_ara_star(size_t width, size_t height, Position from)
+static std::vector<Position> find_path_a_star(const char *input, size_t width, size_t height, Position from, Position to, float weight)
 {
-  frames_until_iteration = 0;
-  eps = 10;
-  openList = { from };
+  const nav::GridMap map = make_nav_map(input, width, height);
+  const nav::GridRect limits{0, 0, int(width), int(height)};
+  const std::vector<size_t> tiles = nav::find_grid_path(map, {from.x, from.y}, {to.x, to.y}, limits, weight,
+    [&](size_t tile, float g) { draw_expanded_tile(tile, g, width); });
+  return tiles_to_path(tiles, width);
+}
 
-  g.clear();
-  g.resize(width * height, std::numeric_limits<float>::max());
-  g[coord_to_idx(from.x, from.y, width)] = 0;
+// epsilon goes down from the initial one as far as the per frame budget allows, the search is reused between passes
+constexpr float ara_initial_epsilon = 10.f;
+constexpr std::chrono::microseconds ara_frame_budget{2000};
+static nav::AraStar ara;
 
-  prev.clear();
-  prev.resize(width * height, {-1,-1});
+static void reset_ara_star(const char *input, size_t width, size_t height, Position from, Position to)
+{
+  nav::init_ara_star(ara, make_nav_map(input, width, height), {from.x, from.y}, {to.x, to.y}, ara_initial_epsilon);
 }
 
 void draw_nav_a_star_data(const char *input, size_t width, size_t height, Position from, Position to, float weight)
@@ -294,23 +157,28 @@ void draw_nav_a_star_data(const char *input, size_t width, size_t height, Positi
   draw_path(path);
 }
 
-static std::vector<Position> curPath;
+// search state survives between frames, only tiles affected by edits or start moves are expanded (and drawn)
+static nav::DStarLite dstar;
 
-void draw_nav_ara_star_data(const char* input, size_t width, size_t height, Position from, Position to, float weight)
+static void reset_dstar_lite(const char *input, size_t width, size_t height, Position from, Position to)
 {
-  draw_nav_grid(input, width, height);
-  frames_until_iteration--;
+  nav::init_dstar_lite(dstar, make_nav_map(input, width, height), {from.x, from.y}, {to.x, to.y});
+}
 
-  if (frames_until_iteration < 0)
-  {
-    eps -= 0.5f;
-    if (eps <= 1.f || openList.empty())
-      reset_ara_star(width, height, from);
-    frames_until_iteration = 30;
-    curPath = find_path_ara_star(input, width, height, from, to, eps);
-  }
+void draw_nav_dstar_data(const char *input, size_t width, size_t height)
+{
+  draw_nav_grid(input, width, height);
+  const std::vector<size_t> tiles = nav::find_dstar_path(dstar, [&](size_t tile, float g) { draw_expanded_tile(tile, g, width); });
+  draw_path(tiles_to_path(tiles, width));
+}
 
-  draw_path(curPath);
+void draw_nav_ara_star_data(const char *input, size_t width, size_t height)
+{
+  draw_nav_grid(input, width, height);
+  if (nav::improve_ara_star(ara, nav::AraClock::now() + ara_frame_budget,
+                            [&](size_t tile, float g) { draw_expanded_tile(tile, g, width); }))
+    printf("ara* bound %0.2f (epsilon %0.1f)\n", double(ara.bound), double(ara.epsilon));
+  draw_path(tiles_to_path(ara.path, width));
 }
 
 int main(int /*argc*/, const char ** /*argv*/)
@@ -333,6 +201,7 @@ int main(int /*argc*/, const char ** /*argv*/)
   char *navGrid = new char[dungWidth * dungHeight];
   gen_drunk_dungeon(navGrid, dungWidth, dungHeight, 24, 100);
   spill_drunk_water(navGrid, dungWidth, dungHeight, 8, 10);
+  nav::build_grid_components(make_nav_map(navGrid, dungWidth, dungHeight), components);
   float weight = 1.f;
 
   Position from = dungeon::find_walkable_tile(navGrid, dungWidth, dungHeight);
@@ -342,7 +211,11 @@ int main(int /*argc*/, const char ** /*argv*/)
   //camera.offset = Vector2{ width * 0.5f, height * 0.5f };
   camera.zoom = float(height) / float(dungHeight);
 
+  reset_ara_star(navGrid, dungWidth, dungHeight, from, to);
+  reset_dstar_lite(navGrid, dungWidth, dungHeight, from, to);
+
   bool isAraMode = false;
+  bool isDStarMode = false;
   SetTargetFPS(30);               // Set our game to run at 30 frames-per-second
   while (!WindowShouldClose())
   {
@@ -353,27 +226,38 @@ int main(int /*argc*/, const char ** /*argv*/)
     {
       size_t idx = coord_to_idx(p.x, p.y, dungWidth);
       if (idx < dungWidth * dungHeight)
+      {
         navGrid[idx] = navGrid[idx] == ' ' ? '#' : navGrid[idx] == '#' ? 'o' : ' ';
+        const int tileX = int(idx % dungWidth);
+        const int tileY = int(idx / dungWidth);
+        nav::update_grid_components(make_nav_map(navGrid, dungWidth, dungHeight), {tileX, tileY, tileX + 1, tileY + 1}, components);
+        nav::update_dstar_tile(dstar, idx);
+        reset_ara_star(navGrid, dungWidth, dungHeight, from, to);
+      }
     }
     else if (IsMouseButtonPressed(0))
     {
       Position &target = from;
       target = p;
-      reset_ara_star(dungWidth, dungHeight, from);
+      reset_ara_star(navGrid, dungWidth, dungHeight, from, to);
+      nav::move_dstar_start(dstar, {from.x, from.y});
     }
     else if (IsMouseButtonPressed(1))
     {
       Position &target = to;
       target = p;
-      reset_ara_star(dungWidth, dungHeight, from);
+      reset_ara_star(navGrid, dungWidth, dungHeight, from, to);
+      reset_dstar_lite(navGrid, dungWidth, dungHeight, from, to);
     }
     if (IsKeyPressed(KEY_SPACE))
     {
       gen_drunk_dungeon(navGrid, dungWidth, dungHeight, 24, 100);
       spill_drunk_water(navGrid, dungWidth, dungHeight, 8, 10);
+      nav::build_grid_components(make_nav_map(navGrid, dungWidth, dungHeight), components);
       from = dungeon::find_walkable_tile(navGrid, dungWidth, dungHeight);
       to = dungeon::find_walkable_tile(navGrid, dungWidth, dungHeight);
-      reset_ara_star(dungWidth, dungHeight, from);
+      reset_ara_star(navGrid, dungWidth, dungHeight, from, to);
+      reset_dstar_lite(navGrid, dungWidth, dungHeight, from, to);
     }
     if (IsKeyPressed(KEY_UP))
     {
@@ -388,14 +272,21 @@ int main(int /*argc*/, const char ** /*argv*/)
     if (IsKeyPressed(KEY_ENTER))
     {
       isAraMode = !isAraMode;
-      reset_ara_star(dungWidth, dungHeight, from);
+      reset_ara_star(navGrid, dungWidth, dungHeight, from, to);
       printf("Ara pathfinding mode: %s", isAraMode ? "true\n" : "false\n");
     }
+    if (IsKeyPressed(KEY_D))
+    {
+      isDStarMode = !isDStarMode;
+      printf("D* Lite pathfinding mode: %s", isDStarMode ? "true\n" : "false\n");
+    }
     BeginDrawing();
       ClearBackground(BLACK);
       BeginMode2D(camera);
-      if (isAraMode)
-        draw_nav_ara_star_data(navGrid, dungWidth, dungHeight, from, to, weight);
+      if (isDStarMode)
+        draw_nav_dstar_data(navGrid, dungWidth, dungHeight);
+      else if (isAraMode)
+        draw_nav_ara_star_data(navGrid, dungWidth, dungHeight);
       else
         draw_nav_a_star_data(navGrid, dungWidth, dungHeight, from, to, weight);
       EndMode2D();
@@ -0,0 +1,201 @@
+#include "goapAgent.h"
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include "ecsTypes.h"
+#include "raylib.h"
+#include "blackboard.h"
+#include "aiUtils.h"
+#include "goapDomains.h"
+
+constexpr float enemy_vis_dist = 8.f;
+constexpr float enemy_ranged_dist = 4.f;
+constexpr float injured_hp = 50.f;
+
+static const goap::Planner &get_monster_planner()
+{
+  static const goap::Planner planner = goap::create_planner_from_static(monster_goap::domain);
+  return planner;
+}
+
+struct AgentPlanRequest
+{
+  flecs::entity agent;
+  uint32_t id;
+  goap::WorldState from;
+  goap::WorldState to;
+};
+
+struct AgentPlanResult
+{
+  flecs::entity agent;
+  uint32_t id;
+  std::vector<goap::PlanStep> plan;
+};
+
+// Single worker thread planning requests in order of arrival, results are picked up by the game thread.
+class BackgroundPlanner
+{
+  const goap::Planner &planner;
+  std::mutex mutex;
+  std::condition_variable hasRequests;
+  std::deque<AgentPlanRequest> requests;
+  std::vector<AgentPlanResult> results;
+  bool stopping = false;
+  std::thread worker; // started last, when everything it uses is constructed
+
+  void run()
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true)
+    {
+      hasRequests.wait(lock, [&]() { return stopping || !requests.empty(); });
+      if (stopping)
+        return;
+      AgentPlanRequest req = std::move(requests.front());
+      requests.pop_front();
+      lock.unlock();
+      AgentPlanResult res{req.agent, req.id, {}};
+      goap::make_plan(planner, req.from, req.to, res.plan);
+      lock.lock();
+      results.emplace_back(std::move(res));
+    }
+  }
+public:
+  BackgroundPlanner(const goap::Planner &in_planner) : planner(in_planner), worker([this]() { run(); }) {}
+  ~BackgroundPlanner()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+    }
+    hasRequests.notify_one();
+    worker.join();
+  }
+
+  void submit(AgentPlanRequest &&req)
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      requests.emplace_back(std::move(req));
+    }
+    hasRequests.notify_one();
+  }
+
+  void collect(std::vector<AgentPlanResult> &out)
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    out.swap(results);
+    results.clear();
+  }
+};
+
+static BackgroundPlanner &get_background_planner()
+{
+  static BackgroundPlanner backgroundPlanner(get_monster_planner());
+  return backgroundPlanner;
+}
+
+// sensors
+static goap::WorldState sense_world_state(const goap::Planner &planner, Blackboard &bb)
+{
+  const float hp = bb.get<float>("hp");
+  const float enemyDist = bb.get<float>("enemyDist");
+  const bool enemyVisible = enemyDist <= enemy_vis_dist;
+  const int distState = !enemyVisible ? DistFar : enemyDist <= 1.f ? DistMelee : enemyDist <= enemy_ranged_dist ? DistRanged : DistFar;
+  return goap::produce_planner_worldstate(planner,
+      {{"enemy_vis", enemyVisible ? 1 : 0},
+       {"enemy_alive", enemyDist < 100.f ? 1 : 0}, // see gather_world_info, it's 100 when there are no enemies
+       {"enemy_dist", distState},
+       {"health_state", hp <= 0.f ? Dead : hp < injured_hp ? Injured : Healthy}});
+}
+
+// step is done when states changed by its action have the values expected by the plan
+static bool is_step_done(const goap::Planner &planner, const goap::PlanStep &step, const goap::WorldState &ws)
+{
+  const goap::Action &action = planner.actions[step.action];
+  for (size_t i = 0; i < ws.size(); ++i)
+  {
+    const bool affected = action.setBitset[i] ? action.effect[i] >= 0 : action.effect[i] != 0;
+    if (affected && ws[i] != step.worldState[i])
+      return false;
+  }
+  return true;
+}
+
+static void execute_step(flecs::world &ecs, flecs::entity entity, size_t action_id)
+{
+  switch (action_id)
+  {
+  case monster_goap::wander:
+    entity.set([&](Action &a) { a.action = GetRandomValue(EA_MOVE_START, EA_MOVE_END - 1); });
+    break;
+  case monster_goap::approach_enemy:
+  case monster_goap::attack_enemy: // attack is a move into the enemy
+    on_closest_enemy_pos(ecs, entity, [&](Action &a, const Position &pos, const Position &enemy_pos)
+    {
+      a.action = move_towards(pos, enemy_pos);
+    });
+    break;
+  case monster_goap::flee_enemy:
+    on_closest_enemy_pos(ecs, entity, [&](Action &a, const Position &pos, const Position &enemy_pos)
+    {
+      a.action = inverse_move(move_towards(pos, enemy_pos));
+    });
+    break;
+  case monster_goap::patch_up:
+    entity.set([&](Action &a) { a.action = EA_HEAL_SELF; });
+    break;
+  }
+}
+
+flecs::entity create_goap_monster(flecs::entity e)
+{
+  GoapAgent agent;
+  agent.goal = goap::produce_planner_worldstate(get_monster_planner(), {{"enemy_alive", 0}, {"health_state", Healthy}});
+  e.add<WorldInfoGatherer>()
+   .set(agent);
+  return e;
+}
+
+void process_goap_agents(flecs::world &ecs)
+{
+  static auto goapAgentsQuery = ecs.query<GoapAgent, Blackboard>();
+  static std::vector<AgentPlanResult> results;
+  static uint32_t lastRequestId = 0;
+  const goap::Planner &planner = get_monster_planner();
+  BackgroundPlanner &backgroundPlanner = get_background_planner();
+
+  backgroundPlanner.collect(results);
+  for (AgentPlanResult &res : results)
+  {
+    if (!res.agent.is_alive())
+      continue;
+    res.agent.set([&](GoapAgent &agent)
+    {
+      if (agent.pendingRequest != res.id)
+        return; // outdated
+      agent.plan = std::move(res.plan);
+      agent.curStep = 0;
+      agent.pendingRequest = 0;
+    });
+  }
+
+  goapAgentsQuery.each([&](flecs::entity e, GoapAgent &agent, Blackboard &bb)
+  {
+    const goap::WorldState ws = sense_world_state(planner, bb);
+    if (agent.pendingRequest == 0 && ws != agent.requestedFrom)
+    {
+      agent.pendingRequest = ++lastRequestId;
+      agent.requestedFrom = ws;
+      backgroundPlanner.submit({e, agent.pendingRequest, ws, agent.goal});
+    }
+
+    // old plan is followed while it's valid, even if it was made for a slightly different world
+    while (agent.curStep < agent.plan.size() && is_step_done(planner, agent.plan[agent.curStep], ws))
+      agent.curStep++;
+    if (agent.curStep < agent.plan.size() && goap::is_action_valid(planner, agent.plan[agent.curStep].action, ws))
+      execute_step(ecs, e, agent.plan[agent.curStep].action);
+  });
+}
@@ -0,0 +1,20 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <flecs.h>
+#include "goapPlanner.h"
+
+// Monster driven by a GOAP plan. Plans are made by a background planner thread,
+// agent keeps executing its previous plan until the requested one arrives.
+struct GoapAgent
+{
+  goap::WorldState goal;
+  goap::WorldState requestedFrom; // world state the last plan was requested for
+  std::vector<goap::PlanStep> plan;
+  size_t curStep = 0;
+  uint32_t pendingRequest = 0; // 0 - nothing is being planned
+};
+
+flecs::entity create_goap_monster(flecs::entity e);
+// Senses world states of agents, requests plans and converts current plan steps to Actions.
+void process_goap_agents(flecs::world &ecs);
@@ -0,0 +1,189 @@
+#pragma once
+#include "goapStatic.h"
+
+enum EnemyDist
+{
+  DistMelee = 0,
+  DistRanged,
+  DistFar
+};
+
+enum HealthState
+{
+  Dead = 0,
+  Injured,
+  Healthy
+};
+
+namespace enemy_goap
+{
+  enum States
+  {
+    enemy_vis = 0,
+    enemy_alive,
+    have_melee,
+    have_ranged,
+    enemy_dist,
+    health_state,
+    NumStates
+  };
+
+  inline constexpr auto domain = goap::make_static_domain(
+      {"enemy_vis",
+       "enemy_alive",
+       "have_melee",
+       "have_ranged",
+       "enemy_dist",
+       "health_state"},
+      goap::StaticAction{"wander", 1,
+        {{health_state, Healthy}},
+        {{enemy_vis, 1}},
+        {}},
+      goap::StaticAction{"approach_enemy", 1,
+        {{health_state, Healthy}, {enemy_vis, 1}},
+        {},
+        {{enemy_dist, -1}}},
+      goap::StaticAction{"flee_enemy", 1,
+        {{health_state, Healthy}, {enemy_vis, 1}},
+        {},
+        {{enemy_dist, +1}}},
+      goap::StaticAction{"find_melee", 1,
+        {{have_melee, 0}, {health_state, Healthy}},
+        {{have_melee, 1}, {enemy_dist, DistFar}},
+        {}},
+      goap::StaticAction{"find_ranged", 1,
+        {{have_ranged, 0}, {health_state, Healthy}},
+        {{have_ranged, 1}, {enemy_dist, DistFar}},
+        {}},
+      goap::StaticAction{"patch_up", 1,
+        {{health_state, Injured}},
+        {},
+        {{health_state, +1}}},
+      goap::StaticAction{"attack_enemy", 1,
+        {{enemy_vis, 1}, {enemy_alive, 1}, {have_melee, 1}, {enemy_dist, DistMelee}, {health_state, Healthy}},
+        {{enemy_alive, 0}},
+        {{health_state, -1}}},
+      goap::StaticAction{"shoot_enemy", 1,
+        {{enemy_vis, 1}, {enemy_alive, 1}, {have_ranged, 1}, {enemy_dist, DistRanged}, {health_state, Healthy}},
+        {{enemy_alive, 0}},
+        {}});
+  static_assert(domain.num_states == NumStates);
+};
+
+namespace looter_goap
+{
+  enum States
+  {
+    enemy_vis = 0,
+    loot_vis,
+    num_loot,
+    have_melee,
+    have_ranged,
+    enemy_dist,
+    health_state,
+    escaped,
+    NumStates
+  };
+
+  inline constexpr auto domain = goap::make_static_domain(
+      {"enemy_vis",
+       "loot_vis",
+       "num_loot",
+       "have_melee",
+       "have_ranged",
+       "enemy_dist",
+       "health_state",
+       "escaped"},
+      goap::StaticAction{"open_room", 1,
+        {{health_state, Healthy}},
+        {{enemy_vis, 1}, {loot_vis, 1}, {enemy_dist, 2}},
+        {}},
+      goap::StaticAction{"loot", 1,
+        {{health_state, Healthy}, {loot_vis, 1}, {enemy_vis, 0}},
+        {{loot_vis, 0}},
+        {{num_loot, +1}}},
+      goap::StaticAction{"approach_enemy", 1,
+        {{health_state, Healthy}, {enemy_vis, 1}},
+        {},
+        {{enemy_dist, -1}}},
+      goap::StaticAction{"flee_enemy", 1,
+        {{health_state, Healthy}, {enemy_vis, 1}},
+        {},
+        {{enemy_dist, +1}}},
+      goap::StaticAction{"find_melee", 1,
+        {{have_melee, 0}, {health_state, Healthy}},
+        {{have_melee, 1}},
+        {}},
+      goap::StaticAction{"find_ranged", 1,
+        {{have_ranged, 0}, {health_state, Healthy}},
+        {{have_ranged, 1}},
+        {}},
+      goap::StaticAction{"patch_up", 1,
+        {{health_state, Injured}},
+        {},
+        {{health_state, +1}}},
+      goap::StaticAction{"attack_enemy", 1,
+        {{enemy_vis, 1}, {have_melee, 1}, {enemy_dist, DistMelee}, {health_state, Healthy}},
+        {{enemy_vis, 0}},
+        {{health_state, -1}}},
+      goap::StaticAction{"shoot_enemy", 5,
+        {{enemy_vis, 1}, {have_ranged, 1}, {enemy_dist, DistRanged}, {health_state, Healthy}},
+        {{enemy_vis, 0}},
+        {{health_state, -1}}},
+      goap::StaticAction{"escape", 1,
+        {{health_state, Healthy}, {num_loot, 5}},
+        {{escaped, 1}},
+        {}});
+  static_assert(domain.num_states == NumStates);
+};
+
+// Domain of GOAP driven monsters, every action here can be executed in game (see goapAgent.cpp).
+namespace monster_goap
+{
+  enum States
+  {
+    enemy_vis = 0,
+    enemy_alive,
+    enemy_dist,
+    health_state,
+    NumStates
+  };
+
+  // in the same order as in domain
+  enum ActionIds
+  {
+    wander = 0,
+    approach_enemy,
+    flee_enemy,
+    patch_up,
+    attack_enemy
+  };
+
+  inline constexpr auto domain = goap::make_static_domain(
+      {"enemy_vis",
+       "enemy_alive",
+       "enemy_dist",
+       "health_state"},
+      goap::StaticAction{"wander", 1,
+        {{health_state, Healthy}, {enemy_vis, 0}},
+        {{enemy_vis, 1}, {enemy_dist, DistFar}},
+        {}},
+      goap::StaticAction{"approach_enemy", 1,
+        {{health_state, Healthy}, {enemy_vis, 1}},
+        {},
+        {{enemy_dist, -1}}},
+      goap::StaticAction{"flee_enemy", 1,
+        {{enemy_vis, 1}},
+        {},
+        {{enemy_dist, +1}}},
+      goap::StaticAction{"patch_up", 1,
+        {{health_state, Injured}},
+        {},
+        {{health_state, +1}}},
+      goap::StaticAction{"attack_enemy", 1,
+        {{enemy_vis, 1}, {enemy_alive, 1}, {enemy_dist, DistMelee}, {health_state, Healthy}},
+        {{enemy_alive, 0}},
+        {}});
+  static_assert(domain.num_states == NumStates);
+  static_assert(domain.num_actions == attack_enemy + 1);
+};
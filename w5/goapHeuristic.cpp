@@ -0,0 +1,338 @@
+#include "goapHeuristic.h"
+#include "goapPlanner.h"
+#include <algorithm>
+#include <cfloat>
+#include <cstdlib>
+#include <functional>
+#include <queue>
+
+// Patterns are grown greedily from states that are changed by the same actions, as long as the abstract
+// space stays under the limit. Action costs are partitioned between patterns (uniform cost partitioning),
+// so the sum over patterns never overestimates and keeps plans optimal.
+
+static bool is_affected(const goap::Action &action, size_t st)
+{
+  return action.setBitset[st] ? action.effect[st] >= 0 : action.effect[st] != 0;
+}
+
+static size_t get_bucket(int8_t val, int8_t max_val)
+{
+  return val < 0 || val > max_val ? size_t(max_val) + 1 : size_t(val);
+}
+
+static size_t get_abstract_index(const goap::PatternDatabase &pdb, const int8_t *st)
+{
+  size_t res = 0;
+  for (size_t i = 0; i < pdb.states.size(); ++i)
+    res += get_bucket(st[pdb.states[i]], pdb.maxValues[i]) * pdb.strides[i];
+  return res;
+}
+
+static size_t find_root(std::vector<size_t> &parents, size_t i)
+{
+  while (parents[i] != i)
+    i = parents[i] = parents[parents[i]];
+  return i;
+}
+
+static std::vector<std::vector<size_t>> select_patterns(const goap::Planner &planner, const std::vector<int8_t> &max_values,
+                                                        size_t max_pattern_states)
+{
+  const size_t numStates = planner.wdesc.size();
+  std::vector<size_t> weights(numStates * numStates, 0);
+  for (const goap::Action &action : planner.actions)
+    for (size_t i = 0; i < numStates; ++i)
+      for (size_t j = 0; j < numStates; ++j)
+        if (i != j && is_affected(action, j) && (is_affected(action, i) || action.precondition[i] >= 0))
+          weights[std::min(i, j) * numStates + std::max(i, j)]++;
+
+  std::vector<std::pair<size_t, size_t>> links; // weight, i * numStates + j
+  for (size_t i = 0; i < weights.size(); ++i)
+    if (weights[i] > 0)
+      links.push_back({weights[i], i});
+  std::stable_sort(links.begin(), links.end(), [](const auto &lhs, const auto &rhs) { return lhs.first > rhs.first; });
+
+  std::vector<size_t> parents(numStates);
+  std::vector<size_t> sizes(numStates);
+  for (size_t i = 0; i < numStates; ++i)
+  {
+    parents[i] = i;
+    sizes[i] = size_t(max_values[i]) + 2;
+  }
+  for (const auto &link : links)
+  {
+    const size_t a = find_root(parents, link.second / numStates);
+    const size_t b = find_root(parents, link.second % numStates);
+    if (a == b || sizes[a] * sizes[b] > max_pattern_states)
+      continue;
+    parents[b] = a;
+    sizes[a] *= sizes[b];
+  }
+
+  std::vector<std::vector<size_t>> patterns;
+  std::vector<size_t> rootPattern(numStates, size_t(-1));
+  for (size_t i = 0; i < numStates; ++i)
+  {
+    const size_t root = find_root(parents, i);
+    if (sizes[root] > max_pattern_states)
+      continue; // single state with too wide range of values
+    if (rootPattern[root] == size_t(-1))
+    {
+      rootPattern[root] = patterns.size();
+      patterns.emplace_back();
+    }
+    patterns[rootPattern[root]].push_back(i);
+  }
+  return patterns;
+}
+
+static void build_pattern_dists(const goap::Planner &planner, goap::PatternDatabase &pdb, const std::vector<float> &costs)
+{
+  const size_t numAbstract = pdb.numAbstractStates;
+  const size_t numPatternStates = pdb.states.size();
+  std::vector<std::vector<std::pair<size_t, float>>> edges(numAbstract);
+  std::vector<size_t> buckets(numPatternStates);
+  std::vector<std::vector<size_t>> nextBuckets(numPatternStates);
+  for (size_t from = 0; from < numAbstract; ++from)
+  {
+    for (size_t i = 0; i < numPatternStates; ++i)
+      buckets[i] = from / pdb.strides[i] % (size_t(pdb.maxValues[i]) + 2);
+    for (size_t actId = 0; actId < planner.actions.size(); ++actId)
+    {
+      const goap::Action &action = planner.actions[actId];
+      bool isValid = true;
+      for (size_t i = 0; i < numPatternStates && isValid; ++i)
+      {
+        const int8_t pre = action.precondition[pdb.states[i]];
+        isValid = pre < 0 || buckets[i] == size_t(pre);
+      }
+      if (!isValid)
+        continue;
+      for (size_t i = 0; i < numPatternStates; ++i)
+      {
+        const size_t st = pdb.states[i];
+        const int maxVal = pdb.maxValues[i];
+        const size_t outOfRange = size_t(maxVal) + 1;
+        const int delta = action.effect[st];
+        nextBuckets[i].clear();
+        if (!is_affected(action, st))
+          nextBuckets[i].push_back(buckets[i]);
+        else if (action.setBitset[st])
+          nextBuckets[i].push_back(size_t(delta));
+        else if (buckets[i] != outOfRange)
+          nextBuckets[i].push_back(get_bucket(int8_t(std::clamp(int(buckets[i]) + delta, -1, maxVal + 1)), int8_t(maxVal)));
+        else
+        {
+          // folded values could land anywhere which can't be reached from inside of the range
+          nextBuckets[i].push_back(outOfRange);
+          for (int val = 0; val <= maxVal; ++val)
+            if (val - delta < 0 || val - delta > maxVal)
+              nextBuckets[i].push_back(size_t(val));
+        }
+      }
+      std::function<void(size_t, size_t)> addEdges = [&](size_t i, size_t to)
+      {
+        if (i == numPatternStates)
+        {
+          if (to != from)
+            edges[from].push_back({to, costs[actId]});
+          return;
+        }
+        for (size_t bucket : nextBuckets[i])
+          addEdges(i + 1, to + bucket * pdb.strides[i]);
+      };
+      addEdges(0, 0);
+    }
+  }
+
+  // stored reversed, distances are searched from the goal backwards
+  pdb.edgeOffsets.assign(numAbstract + 1, 0);
+  for (size_t from = 0; from < numAbstract; ++from)
+    for (const auto &edge : edges[from])
+      pdb.edgeOffsets[edge.first + 1]++;
+  for (size_t i = 0; i < numAbstract; ++i)
+    pdb.edgeOffsets[i + 1] += pdb.edgeOffsets[i];
+  pdb.edges.resize(pdb.edgeOffsets.back());
+  std::vector<size_t> fill(pdb.edgeOffsets.begin(), pdb.edgeOffsets.end() - 1);
+  for (size_t from = 0; from < numAbstract; ++from)
+    for (const auto &edge : edges[from])
+      pdb.edges[fill[edge.first]++] = {from, edge.second};
+}
+
+// Called under the tables' lock, patterns are only built once.
+static void build_patterns(const goap::Planner &planner, goap::HeuristicTables &tables)
+{
+  const size_t numStates = planner.wdesc.size();
+  std::vector<int8_t> maxValues(numStates, 0);
+  for (const goap::Action &action : planner.actions)
+    for (size_t i = 0; i < numStates; ++i)
+    {
+      maxValues[i] = std::max(maxValues[i], action.precondition[i]);
+      if (action.setBitset[i])
+        maxValues[i] = std::max(maxValues[i], action.effect[i]);
+    }
+
+  tables.patterns.clear();
+  for (const std::vector<size_t> &states : select_patterns(planner, maxValues, tables.maxPatternStates))
+  {
+    goap::PatternDatabase pdb;
+    pdb.states = states;
+    for (size_t st : states)
+    {
+      pdb.maxValues.push_back(maxValues[st]);
+      pdb.strides.push_back(pdb.numAbstractStates);
+      pdb.numAbstractStates *= size_t(maxValues[st]) + 2;
+    }
+    tables.patterns.emplace_back(std::move(pdb));
+  }
+
+  // each action cost is split evenly between patterns it changes
+  std::vector<std::vector<float>> costs(tables.patterns.size(), std::vector<float>(planner.actions.size(), 0.f));
+  for (size_t actId = 0; actId < planner.actions.size(); ++actId)
+  {
+    std::vector<size_t> affectedPatterns;
+    for (size_t p = 0; p < tables.patterns.size(); ++p)
+      if (std::any_of(tables.patterns[p].states.begin(), tables.patterns[p].states.end(),
+                      [&](size_t st) { return is_affected(planner.actions[actId], st); }))
+        affectedPatterns.push_back(p);
+    for (size_t p : affectedPatterns)
+      costs[p][actId] = planner.actions[actId].cost / float(affectedPatterns.size());
+  }
+  for (size_t p = 0; p < tables.patterns.size(); ++p)
+    build_pattern_dists(planner, tables.patterns[p], costs[p]);
+  tables.built = true;
+}
+
+void goap::build_heuristic_tables(Planner &planner, size_t max_pattern_states)
+{
+  planner.heuristicTables = std::make_shared<HeuristicTables>();
+  planner.heuristicTables->maxPatternStates = max_pattern_states;
+  std::lock_guard<std::mutex> lock(planner.heuristicTables->mutex);
+  build_patterns(planner, *planner.heuristicTables);
+}
+
+static std::shared_ptr<const goap::GoalDists> find_goal_dists(const std::vector<goap::PatternDatabase> &patterns,
+                                                              const goap::WorldState &goal)
+{
+  auto res = std::make_shared<goap::GoalDists>();
+  for (size_t p = 0; p < patterns.size(); ++p)
+  {
+    const goap::PatternDatabase &pdb = patterns[p];
+    // abstract states consistent with the goal, there are several if goal doesn't fix all of pattern states
+    std::vector<size_t> goalStates = {0};
+    bool caresAboutPattern = false;
+    for (size_t i = 0; i < pdb.states.size(); ++i)
+    {
+      const int8_t val = goal[pdb.states[i]];
+      caresAboutPattern |= val >= 0;
+      std::vector<size_t> nextGoalStates;
+      for (size_t idx : goalStates)
+      {
+        if (val >= 0)
+          nextGoalStates.push_back(idx + get_bucket(val, pdb.maxValues[i]) * pdb.strides[i]);
+        else
+          for (size_t bucket = 0; bucket < size_t(pdb.maxValues[i]) + 2; ++bucket)
+            nextGoalStates.push_back(idx + bucket * pdb.strides[i]);
+      }
+      goalStates = std::move(nextGoalStates);
+    }
+    if (!caresAboutPattern)
+      continue;
+    std::vector<float> goalDists(pdb.numAbstractStates, FLT_MAX);
+    using QueueEntry = std::pair<float, size_t>;
+    std::priority_queue<QueueEntry, std::vector<QueueEntry>, std::greater<QueueEntry>> queue;
+    for (size_t idx : goalStates)
+    {
+      goalDists[idx] = 0.f;
+      queue.push({0.f, idx});
+    }
+    while (!queue.empty())
+    {
+      const auto [dist, cur] = queue.top();
+      queue.pop();
+      if (dist > goalDists[cur])
+        continue;
+      for (size_t e = pdb.edgeOffsets[cur]; e < pdb.edgeOffsets[cur + 1]; ++e)
+        if (dist + pdb.edges[e].second < goalDists[pdb.edges[e].first])
+        {
+          goalDists[pdb.edges[e].first] = dist + pdb.edges[e].second;
+          queue.push({goalDists[pdb.edges[e].first], pdb.edges[e].first});
+        }
+    }
+    res->patterns.push_back(p);
+    res->dists.emplace_back(std::move(goalDists));
+  }
+  return res;
+}
+
+goap::GoalHeuristic goap::prepare_goal_heuristic(const Planner &planner, const WorldState &goal)
+{
+  return {&planner, planner.heuristicTables, goal, nullptr};
+}
+
+// Distances of a goal are searched once and shared by every search towards it.
+static std::shared_ptr<const goap::GoalDists> get_goal_dists(const goap::Planner &planner, goap::HeuristicTables &tables,
+                                                             const goap::WorldState &goal)
+{
+  {
+    std::lock_guard<std::mutex> lock(tables.mutex);
+    if (!tables.built)
+      build_patterns(planner, tables);
+    const auto itf = tables.goals.find(goal);
+    if (itf != tables.goals.end())
+      return itf->second;
+  }
+  // searched without the lock, other threads planning towards other goals don't wait for it
+  std::shared_ptr<const goap::GoalDists> dists = find_goal_dists(tables.patterns, goal);
+  std::lock_guard<std::mutex> lock(tables.mutex);
+  if (tables.goals.size() >= tables.maxCachedGoals)
+    tables.goals.clear();
+  return tables.goals.emplace(goal, std::move(dists)).first->second;
+}
+
+static bool is_goal_reached_at(const int8_t *from, const goap::WorldState &goal)
+{
+  for (size_t i = 0; i < goal.size(); ++i)
+    if (goal[i] >= 0 && from[i] != goal[i])
+      return false;
+  return true;
+}
+
+float goap::get_heuristic(GoalHeuristic &heur, const WorldState &from)
+{
+  return get_heuristic(heur, from.data());
+}
+
+float goap::get_heuristic(GoalHeuristic &heur, const int8_t *from)
+{
+  const WorldState &to = heur.goal;
+  if (heur.tables && !heur.dists)
+  {
+    if (is_goal_reached_at(from, to))
+      return 0.f;
+    heur.dists = get_goal_dists(*heur.planner, *heur.tables, to);
+  }
+  if (!heur.tables || heur.tables->patterns.empty())
+  {
+    float cost = 0;
+    for (size_t i = 0; i < to.size(); ++i)
+      if (to[i] >= 0) // we care about it
+        cost += float(abs(to[i] - from[i]));
+    return cost;
+  }
+  const std::vector<PatternDatabase> &patterns = heur.tables->patterns;
+  float cost = 0;
+  for (size_t i = 0; i < heur.dists->patterns.size(); ++i)
+  {
+    const float dist = heur.dists->dists[i][get_abstract_index(patterns[heur.dists->patterns[i]], from)];
+    if (dist == FLT_MAX)
+      return FLT_MAX; // goal can't be reached even in abstraction
+    cost += dist;
+  }
+  return cost;
+}
+
+bool goap::is_goal_reached(const WorldState &from, const WorldState &goal)
+{
+  return is_goal_reached_at(from.data(), goal);
+}
@@ -0,0 +1,74 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "goapWorldState.h"
+
+namespace goap
+{
+  struct Planner;
+
+  // Abstraction of the world onto a small group of states. Values outside of [0, maxValues[i]]
+  // are folded into one extra bucket. Abstract transitions are kept reversed (edges into each abstract state).
+  struct PatternDatabase
+  {
+    std::vector<size_t> states;
+    std::vector<int8_t> maxValues;
+    std::vector<size_t> strides;
+    size_t numAbstractStates = 1;
+    std::vector<size_t> edgeOffsets;
+    std::vector<std::pair<size_t, float>> edges; // from, cost
+  };
+
+  // Exact abstract distances to a single goal, patterns that goal doesn't care about are skipped.
+  struct GoalDists
+  {
+    std::vector<size_t> patterns;
+    std::vector<std::vector<float>> dists;
+  };
+
+  struct WorldStateHash
+  {
+    size_t operator()(const WorldState &st) const
+    {
+      size_t hash = 14695981039346656037ull;
+      for (int8_t val : st)
+        hash = (hash ^ uint8_t(val)) * 1099511628211ull;
+      return hash;
+    }
+  };
+
+  // Patterns of a planner and distances to the goals it was asked about. Patterns are built on the first plan after
+  // actions change and goal distances once per goal, planners may be used from several threads at once.
+  struct HeuristicTables
+  {
+    size_t maxPatternStates = 1024;
+    std::mutex mutex;
+    bool built = false; // patterns don't change once built, they're read without the lock
+    std::vector<PatternDatabase> patterns;
+    std::unordered_map<WorldState, std::shared_ptr<const GoalDists>, WorldStateHash> goals;
+    size_t maxCachedGoals = 256; // all of them are dropped above that
+  };
+
+  // Heuristic of a single search. Tables are looked up on the first state which isn't the goal yet,
+  // so searches which start at the goal never touch them.
+  struct GoalHeuristic
+  {
+    const Planner *planner = nullptr;
+    std::shared_ptr<HeuristicTables> tables; // sum of per-state differences without them
+    WorldState goal;
+    std::shared_ptr<const GoalDists> dists;
+  };
+
+  // Builds admissible heuristic tables right away instead of on the first plan.
+  void build_heuristic_tables(Planner &planner, size_t max_pattern_states = 1024);
+  GoalHeuristic prepare_goal_heuristic(const Planner &planner, const WorldState &goal);
+  float get_heuristic(GoalHeuristic &heur, const WorldState &from);
+  // Same for states packed elsewhere, `from` points at as many values as the goal has.
+  float get_heuristic(GoalHeuristic &heur, const int8_t *from);
+  bool is_goal_reached(const WorldState &from, const WorldState &goal);
+};
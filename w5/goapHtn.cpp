@@ -0,0 +1,91 @@
+#include "goapHtn.h"
+
+// decompositions deeper than that are considered to be infinite recursion
+constexpr size_t max_htn_depth = 64;
+
+static size_t get_or_add_task(goap::HtnDomain &domain, const std::string &name)
+{
+  auto itf = domain.taskNames.find(name);
+  if (itf != domain.taskNames.end())
+    return itf->second;
+  domain.taskNames.emplace(name, domain.tasks.size());
+  domain.tasks.push_back({name, {}, nullptr});
+  return domain.tasks.size() - 1;
+}
+
+size_t goap::add_htn_compound_task(HtnDomain &domain, const char *name)
+{
+  return get_or_add_task(domain, name);
+}
+
+size_t goap::add_htn_subgoal(HtnDomain &domain, const char *name, const HtnGoal &goal)
+{
+  const size_t taskId = get_or_add_task(domain, name);
+  domain.tasks[taskId].goal = goal;
+  return taskId;
+}
+
+void goap::add_htn_method(HtnDomain &domain, const char *task_name, const WorldState &precondition,
+                          const std::vector<std::string> &subtasks)
+{
+  HtnMethod method;
+  method.precondition = precondition;
+  for (const std::string &name : subtasks)
+    method.subtasks.push_back(get_or_add_task(domain, name));
+  domain.tasks[get_or_add_task(domain, task_name)].methods.emplace_back(std::move(method));
+}
+
+static bool decompose_task(const goap::Planner &planner, const goap::HtnDomain &domain, size_t task_id, size_t depth,
+                           goap::WorldState &st, std::vector<goap::PlanStep> &plan, float &cost, goap::PlanStats *stats)
+{
+  const goap::HtnTask &task = domain.tasks[task_id];
+  if (task.goal)
+  {
+    const goap::WorldState goal = task.goal(st);
+    if (goap::is_goal_reached(st, goal))
+      return true;
+    std::vector<goap::PlanStep> subplan;
+    cost += goap::make_plan(planner, st, goal, subplan, stats);
+    if (subplan.empty())
+      return false;
+    st = subplan.back().worldState;
+    plan.insert(plan.end(), subplan.begin(), subplan.end());
+    return true;
+  }
+  if (depth >= max_htn_depth)
+    return false;
+  for (const goap::HtnMethod &method : task.methods)
+  {
+    if (!goap::is_goal_reached(st, method.precondition))
+      continue;
+    const goap::WorldState prevState = st;
+    const size_t prevPlanSize = plan.size();
+    const float prevCost = cost;
+    bool decomposed = true;
+    for (size_t i = 0; i < method.subtasks.size() && decomposed; ++i)
+      decomposed = decompose_task(planner, domain, method.subtasks[i], depth + 1, st, plan, cost, stats);
+    if (decomposed)
+      return true;
+    st = prevState;
+    plan.resize(prevPlanSize);
+    cost = prevCost;
+  }
+  return false;
+}
+
+float goap::make_htn_plan(const Planner &planner, const HtnDomain &domain, const char *root_task, const WorldState &from,
+                          std::vector<PlanStep> &plan, PlanStats *stats)
+{
+  auto itf = domain.taskNames.find(root_task);
+  if (itf == domain.taskNames.end())
+    return -1.f;
+  WorldState st = from;
+  float cost = 0.f;
+  const size_t prevPlanSize = plan.size();
+  if (!decompose_task(planner, domain, itf->second, 0, st, plan, cost, stats))
+  {
+    plan.resize(prevPlanSize);
+    return -1.f;
+  }
+  return cost;
+}
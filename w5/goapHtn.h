@@ -0,0 +1,44 @@
+#pragma once
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "goapPlanner.h"
+
+// Hierarchical layer over the planner: compound tasks are decomposed by methods into subtasks,
+// leaf tasks are subgoals each solved by a separate (short) make_plan search.
+namespace goap
+{
+  using HtnGoal = std::function<WorldState(const WorldState &from)>;
+
+  struct HtnMethod
+  {
+    WorldState precondition; // -1 - don't care
+    std::vector<size_t> subtasks;
+  };
+
+  struct HtnTask
+  {
+    std::string name;
+    std::vector<HtnMethod> methods; // tried in order, empty for subgoals
+    HtnGoal goal;
+  };
+
+  struct HtnDomain
+  {
+    std::vector<HtnTask> tasks;
+    std::unordered_map<std::string, size_t> taskNames;
+  };
+
+  size_t add_htn_compound_task(HtnDomain &domain, const char *name);
+  size_t add_htn_subgoal(HtnDomain &domain, const char *name, const HtnGoal &goal);
+  // Subtasks are referred by name, a method may use tasks (even its own one) which are added later.
+  void add_htn_method(HtnDomain &domain, const char *task_name, const WorldState &precondition,
+                      const std::vector<std::string> &subtasks);
+
+  // Decomposes `root_task` depth first falling back to the next method if a subtask can't be solved.
+  // Returns cost of the concatenated plan, or -1 if no decomposition works.
+  float make_htn_plan(const Planner &planner, const HtnDomain &domain, const char *root_task, const WorldState &from,
+                      std::vector<PlanStep> &plan, PlanStats *stats = nullptr);
+};
@@ -1,17 +1,10 @@
 #include "goapPlanner.h"
+#include "goapSearchArena.h"
 #include <algorithm>
 #include <cfloat>
-
-struct PlanNode
-{
-  goap::WorldState worldState;
-  goap::WorldState prevState;
-
-  float g = 0;
-  float h = 0;
-
-  size_t actionId;
-};
+#include <cstddef>
+#include <atomic>
+#include <thread>
 
 static float heuristic(const goap::WorldState &from, const goap::WorldState &to)
 {
@@ -22,75 +15,213 @@ static float heuristic(const goap::WorldState &from, const goap::WorldState &to)
   return cost;
 }
 
-static void reconstruct_plan(PlanNode &goal_node, const std::vector<PlanNode> &closed, std::vector<goap::PlanStep> &plan)
+static void reconstruct_plan(size_t goal_node, const goap::SearchArena &arena, std::vector<goap::PlanStep> &plan)
 {
-  PlanNode &curNode = goal_node;
-  while (curNode.actionId != size_t(-1))
+  for (size_t idx = goal_node; arena.nodes[idx].actionId != size_t(-1); idx = arena.nodes[idx].parent)
   {
-    plan.push_back({curNode.actionId, curNode.worldState});
-    auto itf = std::find_if(closed.begin(), closed.end(), [&](const PlanNode &n) { return n.worldState == curNode.prevState; });
-    curNode = *itf;
+    plan.push_back({arena.nodes[idx].actionId, {}});
+    goap::get_search_node_state(arena, idx, plan.back().worldState);
   }
   std::reverse(plan.begin(), plan.end());
 }
 
-float goap::make_plan(const Planner &planner, const WorldState &from, const WorldState &to, std::vector<PlanStep> &plan)
+template<typename IsGoal, typename Heuristic>
+static float a_star_search(const goap::Planner &planner, const goap::WorldState &from, IsGoal is_goal, Heuristic get_h,
+                           size_t max_nodes, std::vector<goap::PlanStep> &plan, goap::SearchArena &arena,
+                           goap::PlanStats *stats)
 {
-  std::vector<PlanNode> openList = {PlanNode{from, from, 0, heuristic(from, to), size_t(-1)}};
-  std::vector<PlanNode> closedList = {};
-  while (!openList.empty())
+  goap::reset_search_arena(arena, from.size());
+  const size_t startIdx = goap::find_or_add_search_node(arena, from).first;
+  arena.nodes[startIdx] = {0, get_h(from), size_t(-1), size_t(-1)};
+  goap::push_open_node(arena, startIdx);
+  goap::WorldState cur;
+  goap::WorldState st;
+  for (size_t numClosed = 0; numClosed < max_nodes; ++numClosed)
   {
-    auto minIt = openList.begin();
-    float minF = minIt->g + minIt->h;
-    for (auto it = openList.begin(); it != openList.end(); ++it)
-      if (it->g + it->h < minF)
-      {
-        minF = it->g + it->h;
-        minIt = it;
-      }
-    PlanNode cur = *minIt;
-    openList.erase(minIt);
-    if (heuristic(cur.worldState, to) == 0) // we've reached our goal
+    const size_t curIdx = goap::pop_open_node(arena);
+    if (curIdx == size_t(-1))
+      break;
+    goap::get_search_node_state(arena, curIdx, cur);
+    const float curG = arena.nodes[curIdx].g;
+    if (is_goal(cur)) // we've reached our goal
     {
-      reconstruct_plan(cur, closedList, plan);
-      return minF;
+      reconstruct_plan(curIdx, arena, plan);
+      return curG + arena.nodes[curIdx].h;
     }
-    closedList.push_back(cur);
-    std::vector<size_t> transitions = find_valid_state_transitions(planner, cur.worldState);
-    //const bool firstIter = openList.empty();
-    //printf("------------\n");
-    for (size_t actId : transitions)
+    if (stats)
+      stats->numExpanded++;
+    for (size_t actId = 0; actId < planner.actions.size(); ++actId)
     {
-      //printf("valid action: %s\n", planner.actions[actId].name.c_str());
-      WorldState st = apply_action(planner, actId, cur.worldState);
-      const float score = cur.g + get_action_cost(planner, actId);
-      auto openIt = std::find_if(openList.begin(), openList.end(), [&](const PlanNode &n) { return st == n.worldState; });
-      auto closeIt = std::find_if(closedList.begin(), closedList.end(), [&](const PlanNode &n) { return st == n.worldState; });
-      if (openIt != openList.end() && score < openIt->g)
+      if (!goap::is_action_valid(planner, actId, cur))
+        continue;
+      st = cur;
+      goap::apply_action_in_place(planner, actId, st);
+      const float score = curG + goap::get_action_cost(planner, actId);
+      const auto [idx, isNew] = goap::find_or_add_search_node(arena, st);
+      goap::SearchNode &node = arena.nodes[idx];
+      if (isNew)
       {
-        openIt->g = score;
-        openIt->prevState = cur.worldState;
+        node = {score, get_h(st), actId, curIdx};
+        goap::push_open_node(arena, idx);
       }
-      if (closeIt != closedList.end() && score < closeIt->g)
+      else if (score < node.g)
       {
-        closeIt->g = score;
-        closeIt->prevState = cur.worldState;
+        // closed nodes only get a better way to them, they aren't expanded again
+        node.g = score;
+        node.actionId = actId;
+        node.parent = curIdx;
+        if (!node.closed)
+          goap::push_open_node(arena, idx);
       }
-      if (closeIt == closedList.end() && openIt == openList.end())
-        openList.push_back({st, cur.worldState, score, heuristic(st, to), actId});
     }
   }
-  return 0.f;
+  return -1.f;
+}
+
+static float make_plan_in_arena(const goap::Planner &planner, const goap::WorldState &from, const goap::WorldState &to,
+                                std::vector<goap::PlanStep> &plan, goap::SearchArena &arena, goap::PlanStats *stats)
+{
+  goap::GoalHeuristic heur = goap::prepare_goal_heuristic(planner, to);
+  const float cost = a_star_search(planner, from,
+      [&](const goap::WorldState &st) { return goap::is_goal_reached(st, to); },
+      [&](const goap::WorldState &st) { return goap::get_heuristic(heur, st); },
+      size_t(-1), plan, arena, stats);
+  return cost < 0.f ? 0.f : cost;
+}
+
+float goap::make_plan(const Planner &planner, const WorldState &from, const WorldState &to, std::vector<PlanStep> &plan,
+                      PlanStats *stats)
+{
+  thread_local SearchArena arena; // reused by all plans made on this thread
+  return make_plan_in_arena(planner, from, to, plan, arena, stats);
+}
+
+void goap::make_plans_batch(const Planner &planner, std::span<const PlanRequest> requests, std::vector<PlanResult> &results,
+                            size_t num_threads)
+{
+  results.resize(requests.size());
+  if (num_threads == 0)
+    num_threads = std::max(size_t(std::thread::hardware_concurrency()), size_t(1));
+  num_threads = std::min(num_threads, requests.size());
+
+  // every request is planned on its own with a freshly reset arena, so which worker picks it
+  // doesn't affect the result and output is the same for any number of threads
+  std::atomic<size_t> nextRequest = 0;
+  auto worker = [&]()
+  {
+    SearchArena arena;
+    for (size_t i = nextRequest++; i < requests.size(); i = nextRequest++)
+    {
+      results[i].plan.clear();
+      results[i].cost = make_plan_in_arena(planner, requests[i].first, requests[i].second, results[i].plan, arena, nullptr);
+    }
+  };
+  std::vector<std::thread> workers;
+  for (size_t i = 1; i < num_threads; ++i)
+    workers.emplace_back(worker);
+  worker();
+  for (std::thread &t : workers)
+    t.join();
+}
+
+static float get_plan_cost(const goap::Planner &planner, const std::vector<goap::PlanStep> &plan)
+{
+  float cost = 0.f;
+  for (const goap::PlanStep &step : plan)
+    cost += goap::get_action_cost(planner, step.action);
+  return cost;
+}
+
+// Replays plan from the actual state refreshing stored world states, steps left after the goal is reached are dropped.
+// Returns index of the first step which can't be executed (plan.size() if all of them can), `st` is the state before it.
+static size_t validate_plan(const goap::Planner &planner, const goap::WorldState &from, const goap::WorldState &to,
+                            std::vector<goap::PlanStep> &plan, goap::WorldState &st)
+{
+  st = from;
+  for (size_t i = 0; i < plan.size(); ++i)
+  {
+    if (goap::is_goal_reached(st, to))
+    {
+      plan.resize(i);
+      break;
+    }
+    if (!goap::is_action_valid(planner, plan[i].action, st))
+      return i;
+    st = goap::apply_action(planner, plan[i].action, st);
+    plan[i].worldState = st;
+  }
+  return plan.size();
+}
+
+float goap::repair_plan(const Planner &planner, const WorldState &from, const WorldState &to, std::vector<PlanStep> &plan,
+                        size_t max_local_nodes)
+{
+  WorldState st;
+  const size_t brokenStep = validate_plan(planner, from, to, plan, st);
+  if (brokenStep == plan.size() && is_goal_reached(st, to))
+    return get_plan_cost(planner, plan);
+
+  // states after the broken step are what the old search already proved to lead to the goal,
+  // so the local search tries to reconnect to them before falling back to a full plan
+  const bool tailReachesGoal = !plan.empty() && is_goal_reached(plan.back().worldState, to);
+  const size_t targetsEnd = tailReachesGoal ? plan.size() : brokenStep;
+  std::vector<float> tailCost(plan.size(), 0.f);
+  for (size_t i = plan.size(); i > 1; --i)
+    tailCost[i - 2] = tailCost[i - 1] + get_action_cost(planner, plan[i - 1].action);
+
+  GoalHeuristic heur = prepare_goal_heuristic(planner, to);
+  size_t reconnectStep = plan.size();
+  auto isReconnected = [&](const WorldState &ws)
+  {
+    if (is_goal_reached(ws, to))
+    {
+      reconnectStep = plan.size();
+      return true;
+    }
+    for (size_t i = brokenStep; i < targetsEnd; ++i)
+      if (ws == plan[i].worldState)
+      {
+        reconnectStep = i + 1;
+        return true;
+      }
+    return false;
+  };
+  auto localHeuristic = [&](const WorldState &ws)
+  {
+    float h = get_heuristic(heur, ws);
+    for (size_t i = brokenStep; i < targetsEnd; ++i)
+      h = std::min(h, heuristic(ws, plan[i].worldState) + tailCost[i]);
+    return h;
+  };
+
+  thread_local SearchArena arena;
+  std::vector<PlanStep> bridge;
+  if (a_star_search(planner, st, isReconnected, localHeuristic, max_local_nodes, bridge, arena, nullptr) >= 0.f)
+  {
+    std::vector<PlanStep> repaired(plan.begin(), plan.begin() + std::ptrdiff_t(brokenStep));
+    repaired.insert(repaired.end(), bridge.begin(), bridge.end());
+    repaired.insert(repaired.end(), plan.begin() + std::ptrdiff_t(reconnectStep), plan.end());
+    if (validate_plan(planner, from, to, repaired, st) == repaired.size() && is_goal_reached(st, to))
+    {
+      plan = std::move(repaired);
+      return get_plan_cost(planner, plan);
+    }
+  }
+  plan.clear();
+  return make_plan_in_arena(planner, from, to, plan, arena, nullptr);
 }
 
-static float ida_star_search(const goap::Planner &planner, std::vector<goap::PlanStep> &plan, const float g, const float bound, const goap::WorldState &to)
+static float ida_star_search(const goap::Planner &planner, std::vector<goap::PlanStep> &plan, const float g, const float bound, goap::GoalHeuristic &heur,
+                             goap::PlanStats *stats)
 {
   const goap::PlanStep p = plan.back();
-  const float f = g + heuristic(p.worldState, to);
+  const float f = g + goap::get_heuristic(heur, p.worldState);
   if (f > bound)
     return f;
-  if (heuristic(p.worldState, to) == 0)
+  if (goap::is_goal_reached(p.worldState, heur.goal))
     return -f;
+  if (stats)
+    stats->numExpanded++;
   float min = FLT_MAX;
   auto checkNeighbour = [&](size_t actId) -> float
   {
@@ -99,7 +230,7 @@ static float ida_star_search(const goap::Planner &planner, std::vector<goap::Pla
       return 0.f;
     plan.push_back({ actId, st });
     float gScore = g + get_action_cost(planner, actId);
-    const float t = ida_star_search(planner, plan, gScore, bound, to);
+    const float t = ida_star_search(planner, plan, gScore, bound, heur, stats);
     if (t < 0.f)
       return t;
     if (t < min)
@@ -118,13 +249,17 @@ static float ida_star_search(const goap::Planner &planner, std::vector<goap::Pla
   return min;
 }
 
-float goap::make_plan_ida(const Planner &planner, const WorldState &from, const WorldState &to, std::vector<PlanStep> &plan)
+float goap::make_plan_ida(const Planner &planner, const WorldState &from, const WorldState &to, std::vector<PlanStep> &plan,
+                          PlanStats *stats)
 {
-  float bound = heuristic(from, to);
+  if (is_goal_reached(from, to))
+    return 0.f; // -0 cost of an empty plan can't be told apart from the bound below
+  GoalHeuristic heur = prepare_goal_heuristic(planner, to);
+  float bound = get_heuristic(heur, from);
   plan = {{size_t(-1), from}};
   while (true)
   {
-    const float t = ida_star_search(planner, plan, 0.f, bound, to);
+    const float t = ida_star_search(planner, plan, 0.f, bound, heur, stats);
     if (t < 0.f) {
       plan.erase(plan.begin());
       return t;
@@ -0,0 +1,120 @@
+#include "goapPlanSearch.h"
+#include <algorithm>
+
+goap::PlanSearch goap::begin_plan_search(const Planner &planner, const WorldState &from, const WorldState &to)
+{
+  PlanSearch search;
+  search.planner = &planner;
+  search.heuristic = prepare_goal_heuristic(planner, to);
+  reset_search_arena(search.arena, from.size());
+  find_or_add_search_node(search.arena, from);
+  search.arena.nodes[0] = {0, get_heuristic(search.heuristic, from), size_t(-1), size_t(-1)};
+  push_open_node(search.arena, 0);
+  return search;
+}
+
+goap::PlanSearchStatus goap::step_plan_search(PlanSearch &search, size_t max_nodes, PlanClock::time_point deadline)
+{
+  SearchArena &arena = search.arena;
+  WorldState cur;
+  WorldState st;
+  for (size_t iter = 0; iter < max_nodes && search.status == PS_IN_PROGRESS; ++iter)
+  {
+    if (PlanClock::now() >= deadline)
+      break;
+    const size_t curIdx = pop_open_node(arena);
+    if (curIdx == size_t(-1))
+    {
+      search.status = PS_FAILED;
+      break;
+    }
+    search.numExpanded++;
+    get_search_node_state(arena, curIdx, cur);
+    if (is_goal_reached(cur, search.heuristic.goal))
+    {
+      search.goalNode = curIdx;
+      search.bestNode = curIdx;
+      search.status = PS_FOUND;
+      break;
+    }
+    const float curG = arena.nodes[curIdx].g;
+    for (size_t actId = 0; actId < search.planner->actions.size(); ++actId)
+    {
+      if (!is_action_valid(*search.planner, actId, cur))
+        continue;
+      st = cur;
+      apply_action_in_place(*search.planner, actId, st);
+      const float score = curG + get_action_cost(*search.planner, actId);
+      const auto [idx, isNew] = find_or_add_search_node(arena, st);
+      SearchNode &node = arena.nodes[idx];
+      if (isNew)
+      {
+        node = {score, get_heuristic(search.heuristic, st), actId, curIdx};
+        const SearchNode &best = arena.nodes[search.bestNode];
+        if (node.h < best.h || (node.h == best.h && score < best.g))
+          search.bestNode = idx;
+        push_open_node(arena, idx);
+      }
+      else if (score < node.g)
+      {
+        node.g = score;
+        node.actionId = actId;
+        node.parent = curIdx;
+        if (!node.closed)
+          push_open_node(arena, idx);
+      }
+    }
+  }
+  return search.status;
+}
+
+float goap::get_best_plan(const PlanSearch &search, std::vector<PlanStep> &plan)
+{
+  plan.clear();
+  if (search.arena.nodes.empty())
+    return 0.f;
+  const size_t lastNode = search.goalNode != size_t(-1) ? search.goalNode : search.bestNode;
+  for (size_t idx = lastNode; search.arena.nodes[idx].actionId != size_t(-1); idx = search.arena.nodes[idx].parent)
+  {
+    plan.push_back({search.arena.nodes[idx].actionId, {}});
+    get_search_node_state(search.arena, idx, plan.back().worldState);
+  }
+  std::reverse(plan.begin(), plan.end());
+  return search.arena.nodes[lastNode].g;
+}
+
+void goap::add_plan_search(PlanScheduler &scheduler, PlanSearch &search)
+{
+  scheduler.searches.push_back(&search);
+}
+
+void goap::remove_plan_search(PlanScheduler &scheduler, const PlanSearch &search)
+{
+  auto itf = std::find(scheduler.searches.begin(), scheduler.searches.end(), &search);
+  if (itf != scheduler.searches.end())
+    scheduler.searches.erase(itf);
+}
+
+void goap::update_plan_scheduler(PlanScheduler &scheduler, size_t frame_node_budget, PlanClock::time_point deadline)
+{
+  std::vector<PlanSearch*> &searches = scheduler.searches;
+  size_t budget = frame_node_budget;
+  while (budget > 0 && !searches.empty() && PlanClock::now() < deadline)
+  {
+    const size_t share = std::max(budget / searches.size(), size_t(1));
+    const size_t numSearches = searches.size();
+    for (size_t i = 0; i < numSearches && budget > 0; ++i)
+    {
+      PlanSearch &search = *searches[(scheduler.nextSearch + i) % numSearches];
+      const size_t expandedBefore = search.numExpanded;
+      step_plan_search(search, std::min(share, budget), deadline);
+      budget -= std::min(search.numExpanded - expandedBefore, budget);
+      if (search.numExpanded == expandedBefore && search.status == PS_IN_PROGRESS)
+        budget = 0; // deadline has passed
+    }
+    scheduler.nextSearch = (scheduler.nextSearch + 1) % numSearches;
+    searches.erase(std::remove_if(searches.begin(), searches.end(),
+                                  [](const PlanSearch *s) { return s->status != PS_IN_PROGRESS; }),
+                   searches.end());
+  }
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <chrono>
+#include <vector>
+
+#include "goapPlanner.h"
+#include "goapSearchArena.h"
+
+namespace goap
+{
+  enum PlanSearchStatus
+  {
+    PS_IN_PROGRESS = 0,
+    PS_FOUND,
+    PS_FAILED
+  };
+
+  // A* search which keeps its open/closed state between calls, so planning can be spread over several frames.
+  struct PlanSearch
+  {
+    const Planner *planner = nullptr;
+    GoalHeuristic heuristic;
+
+    SearchArena arena;
+
+    size_t bestNode = 0; // closest to the goal by heuristic among explored ones
+    size_t goalNode = size_t(-1);
+    size_t numExpanded = 0;
+    PlanSearchStatus status = PS_IN_PROGRESS;
+  };
+
+  using PlanClock = std::chrono::steady_clock;
+
+  PlanSearch begin_plan_search(const Planner &planner, const WorldState &from, const WorldState &to);
+  // Expands up to `max_nodes` nodes or until `deadline` passes, whatever comes first.
+  PlanSearchStatus step_plan_search(PlanSearch &search, size_t max_nodes,
+                                    PlanClock::time_point deadline = PlanClock::time_point::max());
+  // Writes plan to the goal if it was found, otherwise to the explored state with the lowest heuristic.
+  float get_best_plan(const PlanSearch &search, std::vector<PlanStep> &plan);
+
+  // Shares a global per-frame node budget between all searches in progress.
+  struct PlanScheduler
+  {
+    std::vector<PlanSearch*> searches;
+    size_t nextSearch = 0; // rotates so budget remainder isn't always given to the same searches
+  };
+
+  void add_plan_search(PlanScheduler &scheduler, PlanSearch &search);
+  void remove_plan_search(PlanScheduler &scheduler, const PlanSearch &search);
+  // Steps searches in round-robin order, each getting an equal share of `frame_node_budget`.
+  // Budget left unused by finished searches is handed to the ones still running. Finished searches are removed.
+  void update_plan_scheduler(PlanScheduler &scheduler, size_t frame_node_budget,
+                             PlanClock::time_point deadline = PlanClock::time_point::max());
+};
+
@@ -2,13 +2,26 @@
 
 goap::Planner goap::create_planner()
 {
-  return Planner();
+  Planner planner;
+  planner.heuristicTables = std::make_shared<HeuristicTables>();
+  return planner;
+}
+
+// Tables in use by other copies or searches stay as they are, this planner gets new ones built on its next plan.
+static void reset_heuristic_tables(goap::Planner &planner)
+{
+  if (!planner.heuristicTables)
+    return;
+  auto tables = std::make_shared<goap::HeuristicTables>();
+  tables->maxPatternStates = planner.heuristicTables->maxPatternStates;
+  planner.heuristicTables = std::move(tables);
 }
 
 void goap::add_states_to_planner(Planner &planner, const std::vector<std::string> &state_names)
 {
   for (const std::string &name : state_names)
     planner.wdesc.emplace(name, planner.wdesc.size());
+  reset_heuristic_tables(planner);
 }
 
 
@@ -26,6 +39,7 @@ void goap::add_action_to_planner(Planner &planner, const char *name, float cost,
 
   planner.actionNames.emplace(name, planner.actions.size());
   planner.actions.emplace_back(act);
+  reset_heuristic_tables(planner);
 }
 
 static void set_planner_worldstate(const goap::Planner &planner, goap::WorldState &st, const char *st_name, int8_t val)
@@ -51,33 +65,41 @@ float goap::get_action_cost(const Planner &planner, size_t act_id)
   return planner.actions[act_id].cost;
 }
 
+bool goap::is_action_valid(const Planner &planner, size_t act, const WorldState &from)
+{
+  const Action &action = planner.actions[act];
+  bool isValidAction = true;
+  for (size_t j = 0; j < action.precondition.size() && isValidAction; ++j)
+    isValidAction &= action.precondition[j] < 0 || from[j] == action.precondition[j];
+  return isValidAction;
+}
+
 std::vector<size_t> goap::find_valid_state_transitions(const Planner &planner, const WorldState &from)
 {
   std::vector<size_t> res;
 
   for (size_t i = 0; i < planner.actions.size(); ++i)
-  {
-    const Action &action = planner.actions[i];
-    bool isValidAction = true;
-    for (size_t j = 0; j < action.precondition.size() && isValidAction; ++j)
-      isValidAction &= action.precondition[j] < 0 || from[j] == action.precondition[j];
-    if (isValidAction)
+    if (is_action_valid(planner, i, from))
       res.emplace_back(i);
-  }
   return res;
 }
 
 goap::WorldState goap::apply_action(const Planner &planner, size_t act, const WorldState &from)
 {
   WorldState res = from;
+  apply_action_in_place(planner, act, res);
+  return res;
+}
+
+void goap::apply_action_in_place(const Planner &planner, size_t act, WorldState &st)
+{
   const Action &action = planner.actions[act];
   for (size_t i = 0; i < action.effect.size(); ++i)
   {
     if (!action.setBitset[i])
-      res[i] += action.effect[i];
+      st[i] += action.effect[i];
     else if (action.effect[i] >= 0)
-      res[i] = action.effect[i];
+      st[i] = action.effect[i];
   }
-  return res;
 }
 
@@ -1,10 +1,13 @@
 #pragma once
+#include <memory>
 #include <unordered_map>
 #include <vector>
 #include <string>
+#include <span>
 
 #include "goapWorldState.h"
 #include "goapAction.h"
+#include "goapHeuristic.h"
 
 namespace goap
 {
@@ -14,6 +17,8 @@ namespace goap
     WorldDesc wdesc;
     std::vector<Action> actions;
     std::unordered_map<std::string, size_t> actionNames;
+    // shared by copies of the planner, replaced when actions change, null - sum of per-state differences is used
+    std::shared_ptr<HeuristicTables> heuristicTables;
   };
 
   Planner create_planner();
@@ -32,8 +37,10 @@ namespace goap
 
   float get_action_cost(const Planner &planner, size_t act_id);
 
+  bool is_action_valid(const Planner &planner, size_t act, const WorldState &from);
   std::vector<size_t> find_valid_state_transitions(const Planner &planner, const WorldState &from);
   WorldState apply_action(const Planner &planner, size_t act, const WorldState &from);
+  void apply_action_in_place(const Planner &planner, size_t act, WorldState &st);
 
   struct PlanStep
   {
@@ -41,8 +48,40 @@ namespace goap
     WorldState worldState;
   };
 
-  float make_plan(const Planner &planner, const WorldState &from, const WorldState &to, std::vector<PlanStep> &plan);
-  float make_plan_ida(const Planner& planner, const WorldState& from, const WorldState& to, std::vector<PlanStep>& plan);
+  // Filled by planners when passed in, accumulates over calls.
+  struct PlanStats
+  {
+    size_t numExpanded = 0;
+  };
+
+  float make_plan(const Planner &planner, const WorldState &from, const WorldState &to, std::vector<PlanStep> &plan,
+                  PlanStats *stats = nullptr);
+  float make_plan_ida(const Planner& planner, const WorldState& from, const WorldState& to, std::vector<PlanStep>& plan,
+                      PlanStats *stats = nullptr);
+  // Searches backwards from the goal over actions relevant to it, cheap when the goal fixes only a few states.
+  float make_plan_regressive(const Planner &planner, const WorldState &from, const WorldState &to, std::vector<PlanStep> &plan,
+                             PlanStats *stats = nullptr);
+  // Chooses forward or regressive search by which direction has the smaller estimated branching factor.
+  float make_plan_auto(const Planner &planner, const WorldState &from, const WorldState &to, std::vector<PlanStep> &plan,
+                       PlanStats *stats = nullptr);
+  // Re-validates the remaining steps of `plan` against the actual state `from` and patches it in place.
+  // A broken step is bridged by a local search (bounded by `max_local_nodes`) that reconnects to the
+  // still usable tail of the old plan, full replanning is done only if that fails.
+  float repair_plan(const Planner &planner, const WorldState &from, const WorldState &to, std::vector<PlanStep> &plan,
+                    size_t max_local_nodes = 256);
+
+  using PlanRequest = std::pair<WorldState, WorldState>; // from, to
+  struct PlanResult
+  {
+    std::vector<PlanStep> plan;
+    float cost = 0.f;
+  };
+
+  // Plans every request with make_plan spreading them over `num_threads` workers (0 - hardware concurrency),
+  // results[i] corresponds to requests[i] and doesn't depend on the number of threads.
+  void make_plans_batch(const Planner &planner, std::span<const PlanRequest> requests, std::vector<PlanResult> &results,
+                        size_t num_threads = 0);
+
   void print_plan(const Planner &planner, const WorldState &init, const std::vector<PlanStep> &plan);
 };
 
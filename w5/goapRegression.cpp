@@ -0,0 +1,159 @@
+#include "goapPlanner.h"
+#include "goapSearchArena.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+
+// Regressive search works on partial states (-1 - we don't care about value) starting from the goal
+// and looking for a set of conditions that already holds in the initial state.
+
+static float heuristic(const goap::WorldState &from, const goap::WorldState &to)
+{
+  float cost = 0;
+  for (size_t i = 0; i < to.size(); ++i)
+    if (to[i] >= 0) // we care about it
+      cost += float(abs(to[i] - from[i]));
+  return cost;
+}
+
+// Produces conditions which should hold before `action` so `goal` holds after it.
+// Returns false if action is irrelevant for the goal (doesn't achieve any of its values) or contradicts it.
+static bool regress_goal(const goap::Action &action, const goap::WorldState &goal, goap::WorldState &res)
+{
+  bool achievesGoal = false;
+  res.resize(goal.size());
+  for (size_t i = 0; i < goal.size(); ++i)
+  {
+    const int8_t pre = action.precondition[i];
+    const int8_t eff = action.effect[i];
+    if (!action.setBitset[i]) // additive effect, value before action is shifted back
+    {
+      if (goal[i] < 0)
+      {
+        res[i] = pre;
+        continue;
+      }
+      const int before = goal[i] - eff;
+      if (before < 0 || before > INT8_MAX || (pre >= 0 && pre != before))
+        return false;
+      achievesGoal |= eff != 0;
+      res[i] = int8_t(before);
+    }
+    else if (eff >= 0)
+    {
+      if (goal[i] >= 0 && goal[i] != eff)
+        return false;
+      achievesGoal |= goal[i] >= 0;
+      res[i] = pre;
+    }
+    else
+    {
+      if (goal[i] >= 0 && pre >= 0 && goal[i] != pre)
+        return false;
+      res[i] = goal[i] >= 0 ? goal[i] : pre;
+    }
+  }
+  return achievesGoal;
+}
+
+float goap::make_plan_regressive(const Planner &planner, const WorldState &from, const WorldState &to,
+                                 std::vector<PlanStep> &plan, PlanStats *stats)
+{
+  thread_local SearchArena arena;
+  reset_search_arena(arena, to.size());
+  const size_t goalIdx = find_or_add_search_node(arena, to).first;
+  arena.nodes[goalIdx] = {0, heuristic(from, to), size_t(-1), size_t(-1)};
+  push_open_node(arena, goalIdx);
+  WorldState cur;
+  WorldState regressed;
+  for (size_t curIdx = pop_open_node(arena); curIdx != size_t(-1); curIdx = pop_open_node(arena))
+  {
+    get_search_node_state(arena, curIdx, cur);
+    if (heuristic(from, cur) == 0) // initial state satisfies all conditions
+    {
+      // regression chain is stored from the goal, so walking it back gives actions in execution order
+      WorldState st = from;
+      for (size_t idx = curIdx; arena.nodes[idx].actionId != size_t(-1); idx = arena.nodes[idx].parent)
+      {
+        apply_action_in_place(planner, arena.nodes[idx].actionId, st);
+        plan.push_back({arena.nodes[idx].actionId, st});
+      }
+      return arena.nodes[curIdx].g;
+    }
+    if (stats)
+      stats->numExpanded++;
+    const float curG = arena.nodes[curIdx].g;
+    for (size_t actId = 0; actId < planner.actions.size(); ++actId)
+    {
+      if (!regress_goal(planner.actions[actId], cur, regressed))
+        continue;
+      const float score = curG + get_action_cost(planner, actId);
+      const auto [idx, isNew] = find_or_add_search_node(arena, regressed);
+      SearchNode &node = arena.nodes[idx];
+      if (isNew)
+      {
+        node = {score, heuristic(from, regressed), actId, curIdx};
+        push_open_node(arena, idx);
+      }
+      else if (score < node.g && !node.closed)
+      {
+        node.g = score;
+        node.actionId = actId;
+        node.parent = curIdx;
+        push_open_node(arena, idx);
+      }
+    }
+  }
+  return 0.f;
+}
+
+// Branching is estimated by expanding a couple of layers in each direction and averaging
+// the number of distinct successors per expanded state.
+constexpr size_t branching_probe_depth = 2;
+
+template<typename Expand>
+static float estimate_branching(const goap::WorldState &root, Expand expand)
+{
+  std::vector<goap::WorldState> layer = {root};
+  std::vector<goap::WorldState> seen = {root};
+  size_t expanded = 0;
+  size_t successors = 0;
+  for (size_t depth = 0; depth < branching_probe_depth && !layer.empty(); ++depth)
+  {
+    std::vector<goap::WorldState> nextLayer;
+    for (const goap::WorldState &st : layer)
+    {
+      expanded++;
+      expand(st, [&](const goap::WorldState &next)
+      {
+        if (std::find(seen.begin(), seen.end(), next) != seen.end())
+          return;
+        successors++;
+        seen.push_back(next);
+        nextLayer.push_back(next);
+      });
+    }
+    layer = std::move(nextLayer);
+  }
+  return float(successors) / float(expanded);
+}
+
+float goap::make_plan_auto(const Planner &planner, const WorldState &from, const WorldState &to, std::vector<PlanStep> &plan,
+                           PlanStats *stats)
+{
+  const float forwardBranching = estimate_branching(from, [&](const WorldState &st, auto add)
+  {
+    for (size_t actId : find_valid_state_transitions(planner, st))
+      add(apply_action(planner, actId, st));
+  });
+  const float backwardBranching = estimate_branching(to, [&](const WorldState &st, auto add)
+  {
+    WorldState regressed;
+    for (const Action &action : planner.actions)
+      if (regress_goal(action, st, regressed))
+        add(regressed);
+  });
+  if (backwardBranching < forwardBranching)
+    return make_plan_regressive(planner, from, to, plan, stats);
+  return make_plan(planner, from, to, plan, stats);
+}
@@ -0,0 +1,100 @@
+#include "goapSearchArena.h"
+#include <algorithm>
+#include <cstring>
+#include <functional>
+
+constexpr size_t min_hash_table_size = 64;
+
+static size_t hash_state(const int8_t *st, size_t size)
+{
+  size_t hash = 14695981039346656037ull;
+  for (size_t i = 0; i < size; ++i)
+    hash = (hash ^ uint8_t(st[i])) * 1099511628211ull;
+  return hash;
+}
+
+static void insert_to_hash_table(goap::SearchArena &arena, size_t idx)
+{
+  const size_t mask = arena.hashTable.size() - 1;
+  size_t slot = hash_state(goap::get_search_node_state(arena, idx), arena.stateSize) & mask;
+  while (arena.hashTable[slot] != size_t(-1))
+    slot = (slot + 1) & mask;
+  arena.hashTable[slot] = idx;
+}
+
+void goap::reset_search_arena(SearchArena &arena, size_t state_size)
+{
+  // the table is refilled at the size the previous search needed, not the largest one ever, so small searches
+  // after a big one stay cheap; its capacity is kept and growing back doesn't allocate
+  size_t tableSize = min_hash_table_size;
+  while (tableSize < arena.nodes.size() * 2)
+    tableSize *= 2;
+  arena.stateSize = state_size;
+  arena.states.clear();
+  arena.nodes.clear();
+  arena.openHeap.clear();
+  arena.hashTable.assign(tableSize, size_t(-1));
+}
+
+std::pair<size_t, bool> goap::find_or_add_search_node(SearchArena &arena, const WorldState &st)
+{
+  return find_or_add_search_node(arena, st.data());
+}
+
+std::pair<size_t, bool> goap::find_or_add_search_node(SearchArena &arena, const int8_t *st)
+{
+  const size_t mask = arena.hashTable.size() - 1;
+  for (size_t slot = hash_state(st, arena.stateSize) & mask; arena.hashTable[slot] != size_t(-1); slot = (slot + 1) & mask)
+    if (std::memcmp(get_search_node_state(arena, arena.hashTable[slot]), st, arena.stateSize) == 0)
+      return {arena.hashTable[slot], false};
+
+  const size_t idx = arena.nodes.size();
+  arena.nodes.emplace_back();
+  arena.states.insert(arena.states.end(), st, st + arena.stateSize);
+  // table is kept at most half full, it's doubled and refilled from the nodes otherwise
+  if (arena.nodes.size() * 2 > arena.hashTable.size())
+  {
+    arena.hashTable.assign(arena.hashTable.size() * 2, size_t(-1));
+    for (size_t i = 0; i <= idx; ++i)
+      insert_to_hash_table(arena, i);
+  }
+  else
+    insert_to_hash_table(arena, idx);
+  return {idx, true};
+}
+
+const int8_t *goap::get_search_node_state(const SearchArena &arena, size_t idx)
+{
+  return arena.states.data() + idx * arena.stateSize;
+}
+
+void goap::get_search_node_state(const SearchArena &arena, size_t idx, WorldState &st)
+{
+  const int8_t *state = get_search_node_state(arena, idx);
+  st.assign(state, state + arena.stateSize);
+}
+
+using OpenEntry = std::pair<float, size_t>;
+
+void goap::push_open_node(SearchArena &arena, size_t idx)
+{
+  arena.openHeap.push_back({arena.nodes[idx].g + arena.nodes[idx].h, idx});
+  std::push_heap(arena.openHeap.begin(), arena.openHeap.end(), std::greater<OpenEntry>());
+}
+
+size_t goap::pop_open_node(SearchArena &arena)
+{
+  while (!arena.openHeap.empty())
+  {
+    std::pop_heap(arena.openHeap.begin(), arena.openHeap.end(), std::greater<OpenEntry>());
+    const auto [f, idx] = arena.openHeap.back();
+    arena.openHeap.pop_back();
+    SearchNode &node = arena.nodes[idx];
+    if (!node.closed && f == node.g + node.h)
+    {
+      node.closed = true;
+      return idx;
+    }
+  }
+  return size_t(-1);
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "goapWorldState.h"
+
+namespace goap
+{
+  struct SearchNode
+  {
+    float g = 0;
+    float h = 0;
+
+    size_t actionId;
+    size_t parent;
+    bool closed = false;
+  };
+
+  // Storage of a single best-first search. Node states are packed one after another into one buffer
+  // and found through an open addressing hash table, nodes refer to their parents by index.
+  // Reset keeps capacity of everything, so a warmed up arena searches without heap allocations.
+  struct SearchArena
+  {
+    size_t stateSize = 0;
+    std::vector<int8_t> states;
+    std::vector<SearchNode> nodes;
+    std::vector<std::pair<float, size_t>> openHeap; // f, node idx - ties go to the node added first
+    std::vector<size_t> hashTable; // node idx, -1 for free slots
+  };
+
+  void reset_search_arena(SearchArena &arena, size_t state_size);
+  // Returns node index and whether it was added by this call, new nodes get only their state set.
+  std::pair<size_t, bool> find_or_add_search_node(SearchArena &arena, const WorldState &st);
+  std::pair<size_t, bool> find_or_add_search_node(SearchArena &arena, const int8_t *st); // stateSize values
+  const int8_t *get_search_node_state(const SearchArena &arena, size_t idx);
+  void get_search_node_state(const SearchArena &arena, size_t idx, WorldState &st);
+
+  // Outdated entries (node was closed or got a better score after being pushed) are skipped on pop.
+  void push_open_node(SearchArena &arena, size_t idx);
+  // Popped node is marked closed. Returns -1 if open list is empty.
+  size_t pop_open_node(SearchArena &arena);
+};
@@ -0,0 +1,208 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "goapPlanner.h"
+#include "goapSearchArena.h"
+
+// Domains known at build time can be declared as constexpr data, planning over them is then specialised
+// for the exact domain: states are fixed-size arrays and precondition/effect checks are unrolled per action.
+namespace goap
+{
+  constexpr size_t max_static_conds = 8;
+
+  struct StaticCond
+  {
+    size_t state;
+    int8_t value;
+  };
+
+  struct StaticCondList
+  {
+    std::array<StaticCond, max_static_conds> conds{};
+    size_t size = 0;
+
+    constexpr StaticCondList() = default;
+    constexpr StaticCondList(std::initializer_list<StaticCond> list)
+    {
+      for (const StaticCond &cond : list)
+        conds[size++] = cond;
+    }
+  };
+
+  struct StaticAction
+  {
+    const char *name;
+    float cost;
+    StaticCondList precond;
+    StaticCondList effect;
+    StaticCondList additiveEffect;
+  };
+
+  template<size_t NumStates, size_t NumActions>
+  struct StaticDomain
+  {
+    static constexpr size_t num_states = NumStates;
+    static constexpr size_t num_actions = NumActions;
+
+    std::array<const char*, NumStates> stateNames;
+    std::array<StaticAction, NumActions> actions;
+  };
+
+  template<size_t NumStates, typename... Actions>
+  constexpr auto make_static_domain(const char *const (&state_names)[NumStates], const Actions &...actions)
+  {
+    return StaticDomain<NumStates, sizeof...(Actions)>{std::to_array(state_names), {actions...}};
+  }
+
+  template<size_t NumStates>
+  using PackedState = std::array<int8_t, NumStates>;
+
+  // Runtime planner with the same states and actions, handy to compare against or to print plans.
+  template<typename Domain>
+  Planner create_planner_from_static(const Domain &domain)
+  {
+    Planner planner = create_planner();
+    add_states_to_planner(planner, std::vector<std::string>(domain.stateNames.begin(), domain.stateNames.end()));
+    auto toDescs = [&](const StaticCondList &list)
+    {
+      std::vector<StateDesc> res;
+      for (size_t i = 0; i < list.size; ++i)
+        res.push_back({domain.stateNames[list.conds[i].state], list.conds[i].value});
+      return res;
+    };
+    for (const StaticAction &act : domain.actions)
+      add_action_to_planner(planner, act.name, act.cost, toDescs(act.precond), toDescs(act.effect),
+                            toDescs(act.additiveEffect));
+    build_heuristic_tables(planner);
+    return planner;
+  }
+
+  template<const auto &Domain, size_t Act, size_t N>
+  constexpr bool is_static_action_valid(const PackedState<N> &from)
+  {
+    return [&]<size_t... I>(std::index_sequence<I...>)
+    {
+      return ((from[Domain.actions[Act].precond.conds[I].state] == Domain.actions[Act].precond.conds[I].value) && ...);
+    }(std::make_index_sequence<Domain.actions[Act].precond.size>{});
+  }
+
+  template<const auto &Domain, size_t Act, size_t N>
+  constexpr PackedState<N> apply_static_action(PackedState<N> st)
+  {
+    [&]<size_t... I>(std::index_sequence<I...>)
+    {
+      ((st[Domain.actions[Act].effect.conds[I].state] = Domain.actions[Act].effect.conds[I].value), ...);
+    }(std::make_index_sequence<Domain.actions[Act].effect.size>{});
+    [&]<size_t... I>(std::index_sequence<I...>)
+    {
+      ((st[Domain.actions[Act].additiveEffect.conds[I].state] =
+          int8_t(st[Domain.actions[Act].additiveEffect.conds[I].state] + Domain.actions[Act].additiveEffect.conds[I].value)), ...);
+    }(std::make_index_sequence<Domain.actions[Act].additiveEffect.size>{});
+    return st;
+  }
+
+  // Runtime twin of the domain, built once. Its heuristic tables (and goal distances cached in them) are shared by
+  // every static plan over the domain.
+  template<const auto &Domain>
+  const Planner &get_static_planner()
+  {
+    static const Planner planner = create_planner_from_static(Domain);
+    return planner;
+  }
+
+  template<size_t N>
+  inline bool is_static_goal_reached(const PackedState<N> &from, const PackedState<N> &to)
+  {
+    for (size_t i = 0; i < N; ++i)
+      if (to[i] >= 0 && from[i] != to[i])
+        return false;
+    return true;
+  }
+
+  // Same interface and search as make_plan, heuristic tables are taken from the planner, which has to be made from
+  // the domain by create_planner_from_static. Only precondition checks and effects are unrolled per action and
+  // states are copied as fixed-size arrays.
+  template<const auto &Domain>
+  float make_static_plan(const Planner &planner, const WorldState &from, const WorldState &to, std::vector<PlanStep> &plan,
+                         PlanStats *stats = nullptr)
+  {
+    constexpr size_t numStates = std::remove_cvref_t<decltype(Domain)>::num_states;
+    constexpr size_t numActions = std::remove_cvref_t<decltype(Domain)>::num_actions;
+    using State = PackedState<numStates>;
+
+    State packedFrom;
+    State packedTo;
+    std::memcpy(packedFrom.data(), from.data(), numStates);
+    std::memcpy(packedTo.data(), to.data(), numStates);
+    GoalHeuristic heur = prepare_goal_heuristic(planner, to);
+
+    thread_local SearchArena arena; // reused by all static plans made on this thread
+    reset_search_arena(arena, numStates);
+    const size_t startIdx = find_or_add_search_node(arena, packedFrom.data()).first;
+    arena.nodes[startIdx] = {0, get_heuristic(heur, packedFrom.data()), size_t(-1), size_t(-1)};
+    push_open_node(arena, startIdx);
+    State cur;
+    while (true)
+    {
+      const size_t curIdx = pop_open_node(arena);
+      if (curIdx == size_t(-1))
+        break;
+      std::memcpy(cur.data(), get_search_node_state(arena, curIdx), numStates);
+      const float curG = arena.nodes[curIdx].g;
+      if (is_static_goal_reached(cur, packedTo))
+      {
+        for (size_t idx = curIdx; arena.nodes[idx].actionId != size_t(-1); idx = arena.nodes[idx].parent)
+        {
+          plan.push_back({arena.nodes[idx].actionId, {}});
+          get_search_node_state(arena, idx, plan.back().worldState);
+        }
+        std::reverse(plan.begin(), plan.end());
+        return curG + arena.nodes[curIdx].h;
+      }
+      if (stats)
+        stats->numExpanded++;
+      auto tryAction = [&]<size_t Act>()
+      {
+        if (!is_static_action_valid<Domain, Act>(cur))
+          return;
+        const State st = apply_static_action<Domain, Act>(cur);
+        const float score = curG + Domain.actions[Act].cost;
+        const auto [idx, isNew] = find_or_add_search_node(arena, st.data());
+        SearchNode &node = arena.nodes[idx];
+        if (isNew)
+        {
+          node = {score, get_heuristic(heur, st.data()), Act, curIdx};
+          push_open_node(arena, idx);
+        }
+        else if (score < node.g)
+        {
+          // closed nodes only get a better way to them, they aren't expanded again
+          node.g = score;
+          node.actionId = Act;
+          node.parent = curIdx;
+          if (!node.closed)
+            push_open_node(arena, idx);
+        }
+      };
+      [&]<size_t... Act>(std::index_sequence<Act...>)
+      {
+        (tryAction.template operator()<Act>(), ...);
+      }(std::make_index_sequence<numActions>{});
+    }
+    return 0.f;
+  }
+
+  template<const auto &Domain>
+  float make_static_plan(const WorldState &from, const WorldState &to, std::vector<PlanStep> &plan, PlanStats *stats = nullptr)
+  {
+    return make_static_plan<Domain>(get_static_planner<Domain>(), from, to, plan, stats);
+  }
+};
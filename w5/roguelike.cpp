@@ -10,6 +10,7 @@
 #include "dmapFollower.h"
 #include "dmapBeh.h"
 #include "rlikeObjects.h"
+#include "goapAgent.h"
 
 
 static void register_roguelike_systems(flecs::world &ecs)
@@ -146,6 +147,7 @@ void init_roguelike(flecs::world &ecs)
   create_hive_monster(create_monster(ecs, Color{0xee, 0x00, 0xee, 0xff}, "minotaur_tex"));
   create_hive_monster(create_monster(ecs, Color{0x11, 0x11, 0x11, 0xff}, "minotaur_tex"));
   create_hive(create_player_fleer(create_monster(ecs, Color{0, 255, 0, 255}, "minotaur_tex")));
+  create_goap_monster(create_monster(ecs, Color{0xff, 0x88, 0x00, 0xff}, "minotaur_tex"));
 
   create_player(ecs, "swordsman_tex");
 
@@ -376,6 +378,7 @@ void process_turn(flecs::world &ecs)
           bt.update(ecs, e, bb);
         });
         process_dmap_followers(ecs);
+        process_goap_agents(ecs);
       });
       turnIncrementer.each([](TurnCounter &tc) { tc.count++; });
     }
@@ -0,0 +1,391 @@
+#include "flowField.h"
+#include "dungeonUtils.h"
+#include "gridFlood.h"
+#include <algorithm>
+
+static const nav::TileCosts tile_costs = nav::make_tile_costs({{dungeon::wall, nav::blocked_tile}});
+
+constexpr uint8_t no_flow_dir = 4;
+static const IVec2 flow_dirs[] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}};
+
+constexpr size_t invalid_cluster = size_t(-1);
+// distances are kept exact integers in floats, the field is computed from scratch before the offset gets near 2^24
+constexpr float max_flow_dist_offset = 1e6f;
+
+static size_t get_flow_cluster(const DungeonPortals &dp, const DungeonData &dd, IVec2 tile)
+{
+  const size_t width = dd.width / dp.tileSplit;
+  const size_t height = dd.height / dp.tileSplit;
+  if (tile.x < 0 || tile.y < 0 || size_t(tile.x) >= width * dp.tileSplit || size_t(tile.y) >= height * dp.tileSplit)
+    return invalid_cluster;
+  return size_t(tile.y) / dp.tileSplit * width + size_t(tile.x) / dp.tileSplit;
+}
+
+static nav::GridRect get_cluster_rect(const DungeonPortals &dp, const DungeonData &dd, size_t cluster)
+{
+  const size_t width = dd.width / dp.tileSplit;
+  const int split = int(dp.tileSplit);
+  const int minX = int(cluster % width) * split;
+  const int minY = int(cluster / width) * split;
+  return {minX, minY, minX + split, minY + split};
+}
+
+static void label_portal_components(FlowField &field, const DungeonPortals &dp)
+{
+  const size_t numPortals = dp.portals.size();
+  field.portalComponent.assign(numPortals, nav::invalid_tile);
+  std::vector<uint32_t> stack;
+  uint32_t numComponents = 0;
+  for (size_t idx = 0; idx < numPortals; ++idx)
+  {
+    if (field.portalComponent[idx] != nav::invalid_tile)
+      continue;
+    field.portalComponent[idx] = numComponents;
+    stack.push_back(uint32_t(idx));
+    while (!stack.empty())
+    {
+      const uint32_t cur = stack.back();
+      stack.pop_back();
+      for (uint32_t conn = dp.graph.offsets[cur]; conn < dp.graph.offsets[cur + 1]; ++conn)
+        if (field.portalComponent[dp.graph.neighbours[conn]] == nav::invalid_tile)
+        {
+          field.portalComponent[dp.graph.neighbours[conn]] = numComponents;
+          stack.push_back(dp.graph.neighbours[conn]);
+        }
+    }
+    numComponents++;
+  }
+}
+
+// The target is linked to the portals of its cluster the same way query ends are.
+static void start_portal_search(FlowField &field, const DungeonPortals &dp, const DungeonData &dd)
+{
+  const size_t numPortals = dp.portals.size();
+  field.portalDist.assign(numPortals, nav::blocked_tile);
+  field.portalNext.assign(numPortals, nav::invalid_tile);
+  field.portalCluster.assign(numPortals, uint32_t(invalid_cluster));
+  field.portalSettled.assign(numPortals, 0);
+  field.portalVisit.assign(numPortals, 0);
+  field.visitStamp = 0;
+  nav::reset_open_heap(field.portalOpen, numPortals);
+  field.targetComponents.clear();
+  const size_t targetCluster = get_flow_cluster(dp, dd, field.target);
+  if (targetCluster == invalid_cluster)
+    return;
+  const nav::GridMap map{dd.tiles.data(), dd.width, dd.height, &tile_costs};
+  const nav::GridRect rect = get_cluster_rect(dp, dd, targetCluster);
+  thread_local nav::GridFlood flood;
+  nav::flood_grid(map, {{field.target.x, field.target.y}}, rect, flood);
+  for (size_t idx : dp.tilePortalsIndices[targetCluster])
+  {
+    const PathPortal &portal = dp.portals[idx];
+    float minDist = nav::blocked_tile;
+    for (int y = std::max(int(portal.startY), rect.minY); y <= std::min(int(portal.endY), rect.maxY - 1); ++y)
+      for (int x = std::max(int(portal.startX), rect.minX); x <= std::min(int(portal.endX), rect.maxX - 1); ++x)
+        minDist = std::min(minDist, nav::get_flood_dist(flood, {x, y}));
+    if (minDist == nav::blocked_tile)
+      continue;
+    field.portalDist[idx] = minDist + 1.f;
+    field.portalCluster[idx] = uint32_t(targetCluster);
+    field.targetComponents.push_back(field.portalComponent[idx]);
+    nav::push_open_tile(field.portalOpen, uint32_t(idx), minDist + 1.f);
+  }
+}
+
+static void settle_cluster_portals(FlowField &field, const DungeonPortals &dp, size_t cluster)
+{
+  for (size_t idx : dp.tilePortalsIndices[cluster])
+  {
+    // otherwise the search would run over everything it can reach before giving up
+    if (std::find(field.targetComponents.begin(), field.targetComponents.end(), field.portalComponent[idx]) ==
+        field.targetComponents.end())
+      continue;
+    while (!field.portalSettled[idx] && !nav::is_open_heap_empty(field.portalOpen))
+    {
+      const uint32_t cur = nav::pop_open_tile(field.portalOpen);
+      field.portalSettled[cur] = 1;
+      for (uint32_t conn = dp.graph.offsets[cur]; conn < dp.graph.offsets[cur + 1]; ++conn)
+      {
+        const uint32_t next = dp.graph.neighbours[conn];
+        const float dist = field.portalDist[cur] + dp.graph.costs[conn];
+        if (field.portalSettled[next] || dist >= field.portalDist[next])
+          continue;
+        field.portalDist[next] = dist;
+        field.portalNext[next] = cur;
+        field.portalCluster[next] = dp.graph.clusters[conn];
+        nav::push_open_tile(field.portalOpen, next, dist);
+      }
+    }
+  }
+}
+
+// The clusters themselves plus every cluster on the way from their portals to the target, so each of their tiles
+// which can reach the target at all reaches it through the active clusters.
+static std::vector<size_t> get_route_clusters(FlowField &field, const DungeonPortals &dp, std::vector<size_t> clusters)
+{
+  const size_t numRequested = clusters.size();
+  field.visitStamp++;
+  for (size_t i = 0; i < numRequested; ++i)
+  {
+    settle_cluster_portals(field, dp, clusters[i]);
+    // ways of settled portals only go through settled ones
+    for (size_t idx : dp.tilePortalsIndices[clusters[i]])
+      for (uint32_t portal = uint32_t(idx); portal != nav::invalid_tile && field.portalDist[portal] != nav::blocked_tile &&
+           field.portalVisit[portal] != field.visitStamp; portal = field.portalNext[portal])
+      {
+        field.portalVisit[portal] = field.visitStamp;
+        clusters.push_back(field.portalCluster[portal]);
+      }
+  }
+  std::sort(clusters.begin(), clusters.end());
+  clusters.erase(std::unique(clusters.begin(), clusters.end()), clusters.end());
+  return clusters;
+}
+
+static bool is_tile_active(const FlowField &field, const DungeonPortals &dp, const DungeonData &dd, int x, int y)
+{
+  const size_t cluster = get_flow_cluster(dp, dd, {x, y});
+  return cluster != invalid_cluster && field.clusterActive[cluster];
+}
+
+static void update_tile_dir(FlowField &field, const DungeonData &dd, size_t tile)
+{
+  field.tileDir[tile] = no_flow_dir;
+  float bestDist = field.tileDist[tile];
+  const int x = int(tile % dd.width);
+  const int y = int(tile / dd.width);
+  for (uint8_t dir = 0; dir < no_flow_dir; ++dir)
+  {
+    const int nx = x + flow_dirs[dir].x;
+    const int ny = y + flow_dirs[dir].y;
+    if (nx < 0 || ny < 0 || nx >= int(dd.width) || ny >= int(dd.height))
+      continue;
+    const float dist = field.tileDist[size_t(ny) * dd.width + size_t(nx)];
+    if (dist < bestDist)
+    {
+      bestDist = dist;
+      field.tileDir[tile] = dir;
+    }
+  }
+}
+
+// Decrease-only Dijkstra over active tiles from the tiles in the open heap, directions are fixed around every
+// tile it changed.
+static void propagate_flow_dists(FlowField &field, const DungeonPortals &dp, const DungeonData &dd, nav::OpenHeap &open,
+                                 std::vector<size_t> &changed)
+{
+  const nav::GridMap map{dd.tiles.data(), dd.width, dd.height, &tile_costs};
+  while (!nav::is_open_heap_empty(open))
+  {
+    const uint32_t cur = nav::pop_open_tile(open);
+    field.numSettled++;
+    const int x = int(cur % dd.width);
+    const int y = int(cur / dd.width);
+    for (const IVec2 &dir : flow_dirs)
+    {
+      const int nx = x + dir.x;
+      const int ny = y + dir.y;
+      if (!is_tile_active(field, dp, dd, nx, ny))
+        continue;
+      const size_t next = size_t(ny) * dd.width + size_t(nx);
+      const float cost = nav::get_tile_cost(map, next);
+      if (cost == nav::blocked_tile || field.tileDist[cur] + cost >= field.tileDist[next])
+        continue;
+      field.tileDist[next] = field.tileDist[cur] + cost;
+      changed.push_back(next);
+      nav::push_open_tile(open, uint32_t(next), field.tileDist[next]);
+    }
+  }
+  // a changed distance can turn the neighbours towards the tile
+  for (size_t tile : changed)
+  {
+    update_tile_dir(field, dd, tile);
+    const int x = int(tile % dd.width);
+    const int y = int(tile / dd.width);
+    for (const IVec2 &dir : flow_dirs)
+      if (x + dir.x >= 0 && y + dir.y >= 0 && x + dir.x < int(dd.width) && y + dir.y < int(dd.height))
+        update_tile_dir(field, dd, size_t(y + dir.y) * dd.width + size_t(x + dir.x));
+  }
+}
+
+// Tiles of the already computed field around the new clusters are put in the open heap with their distances and
+// the Dijkstra goes on from them. Distances only go down, so the result is the same as computing from scratch.
+static void activate_clusters(FlowField &field, const DungeonPortals &dp, const DungeonData &dd,
+                              const std::vector<size_t> &clusters)
+{
+  thread_local nav::OpenHeap open;
+  thread_local std::vector<size_t> changed;
+  nav::reset_open_heap(open, dd.width * dd.height);
+  changed.clear();
+  auto openTile = [&](int x, int y)
+  {
+    const size_t tile = size_t(y) * dd.width + size_t(x);
+    if (is_tile_active(field, dp, dd, x, y) && field.tileDist[tile] != nav::blocked_tile)
+      nav::push_open_tile(open, uint32_t(tile), field.tileDist[tile]);
+  };
+
+  const size_t targetCluster = get_flow_cluster(dp, dd, field.target);
+  for (size_t cluster : clusters)
+  {
+    if (field.clusterActive[cluster])
+      continue;
+    field.clusterActive[cluster] = 1;
+    field.activeClusters.push_back(cluster);
+    if (cluster == targetCluster)
+    {
+      const size_t tile = size_t(field.target.y) * dd.width + size_t(field.target.x);
+      field.tileDist[tile] = -field.distOffset;
+      changed.push_back(tile);
+      nav::push_open_tile(open, uint32_t(tile), field.tileDist[tile]);
+    }
+    const nav::GridRect rect = get_cluster_rect(dp, dd, cluster);
+    for (int x = rect.minX; x < rect.maxX; ++x)
+    {
+      if (rect.minY > 0)
+        openTile(x, rect.minY - 1);
+      if (rect.maxY < int(dd.height))
+        openTile(x, rect.maxY);
+    }
+    for (int y = rect.minY; y < rect.maxY; ++y)
+    {
+      if (rect.minX > 0)
+        openTile(rect.minX - 1, y);
+      if (rect.maxX < int(dd.width))
+        openTile(rect.maxX, y);
+    }
+  }
+
+  propagate_flow_dists(field, dp, dd, open, changed);
+}
+
+// A cluster may already be active as a part of somebody else's route, the routes from its own portals are
+// added once it's asked about directly.
+static void request_cluster(FlowField &field, const DungeonPortals &dp, const DungeonData &dd, size_t cluster)
+{
+  if (field.clusterRequested[cluster])
+    return;
+  field.clusterRequested[cluster] = 1;
+  field.requestedClusters.push_back(cluster);
+  std::vector<size_t> clusters = get_route_clusters(field, dp, {cluster});
+  if (std::any_of(clusters.begin(), clusters.end(), [&](size_t route_cluster) { return !field.clusterActive[route_cluster]; }))
+    activate_clusters(field, dp, dd, clusters);
+}
+
+static void clear_flow_field(FlowField &field, const DungeonPortals &dp, const DungeonData &dd)
+{
+  for (size_t cluster : field.activeClusters)
+  {
+    const nav::GridRect rect = get_cluster_rect(dp, dd, cluster);
+    for (int y = rect.minY; y < rect.maxY; ++y)
+      for (int x = rect.minX; x < rect.maxX; ++x)
+      {
+        field.tileDist[size_t(y) * dd.width + size_t(x)] = nav::blocked_tile;
+        field.tileDir[size_t(y) * dd.width + size_t(x)] = no_flow_dir;
+      }
+    field.clusterActive[cluster] = 0;
+  }
+  field.activeClusters.clear();
+  field.distOffset = 0.f;
+}
+
+// Going back to the previous target and then along the old field is a way from every tile, so the old distances
+// plus the cost of the way back bound the new ones from above. That shift is applied to the whole field through
+// the offset, then the Dijkstra from the new target only goes over tiles which got closer than that. The old field
+// is exact over the active clusters, so the repaired one is too. Returns false if the field has to be computed
+// from scratch instead.
+static bool move_flow_field_target(FlowField &field, const DungeonPortals &dp, const DungeonData &dd, IVec2 prev_target)
+{
+  const nav::GridMap map{dd.tiles.data(), dd.width, dd.height, &tile_costs};
+  const size_t prevTile = size_t(prev_target.y) * dd.width + size_t(prev_target.x);
+  const size_t tile = size_t(field.target.y) * dd.width + size_t(field.target.x);
+  // the field counts costs of the tiles entered on the way from its target, the way back enters the old target instead
+  const float wayBack = field.tileDist[tile] + field.distOffset - nav::get_tile_cost(map, tile) +
+                        nav::get_tile_cost(map, prevTile);
+  if (!(wayBack < nav::blocked_tile) || field.distOffset + wayBack > max_flow_dist_offset)
+    return false;
+  field.distOffset += wayBack;
+
+  thread_local nav::OpenHeap open;
+  thread_local std::vector<size_t> changed;
+  nav::reset_open_heap(open, dd.width * dd.height);
+  changed.clear();
+  if (-field.distOffset < field.tileDist[tile])
+  {
+    field.tileDist[tile] = -field.distOffset;
+    changed.push_back(tile);
+  }
+  nav::push_open_tile(open, uint32_t(tile), field.tileDist[tile]);
+  propagate_flow_dists(field, dp, dd, open, changed);
+  return true;
+}
+
+void set_flow_field_target(FlowField &field, const DungeonPortals &dp, const DungeonData &dd, IVec2 target)
+{
+  if (field.portalsVersion == dp.version && field.target == target)
+    return;
+  const size_t numClusters = dp.tilePortalsIndices.size();
+  // tiles behind changed portals may have changed too, nothing of the old field can be kept then
+  bool keepField = field.portalsVersion == dp.version;
+  if (field.clusterActive.size() != numClusters || field.tileDist.size() != dd.width * dd.height)
+  {
+    field.clusterActive.assign(numClusters, 0);
+    field.clusterRequested.assign(numClusters, 0);
+    field.activeClusters.clear();
+    field.requestedClusters.clear();
+    field.tileDist.assign(dd.width * dd.height, nav::blocked_tile);
+    field.tileDir.assign(dd.width * dd.height, no_flow_dir);
+    field.distOffset = 0.f;
+    keepField = false;
+  }
+  if (field.portalsVersion != dp.version)
+    label_portal_components(field, dp);
+  const IVec2 prevTarget = field.target;
+  const size_t prevTargetCluster = get_flow_cluster(dp, dd, prevTarget);
+  const size_t targetCluster = get_flow_cluster(dp, dd, target);
+  keepField = keepField && prevTargetCluster != invalid_cluster && targetCluster != invalid_cluster &&
+              field.clusterActive[prevTargetCluster];
+  // the old field is extended over the new target first, the way back to the old one is read from it
+  if (keepField)
+    activate_clusters(field, dp, dd, {targetCluster});
+  field.portalsVersion = dp.version;
+  field.target = target;
+  start_portal_search(field, dp, dd);
+
+  // clusters nobody asked about since the previous move aren't needed anymore
+  std::vector<size_t> clusters;
+  clusters.swap(field.requestedClusters);
+  for (size_t cluster : clusters)
+    field.clusterRequested[cluster] = 0;
+  if (targetCluster != invalid_cluster)
+    clusters.push_back(targetCluster);
+  const std::vector<size_t> routeClusters = get_route_clusters(field, dp, std::move(clusters));
+  // they stay active while the field is repaired, it's computed from scratch once they outnumber the needed ones
+  if (!keepField || field.activeClusters.size() > 2 * routeClusters.size() ||
+      !move_flow_field_target(field, dp, dd, prevTarget))
+    clear_flow_field(field, dp, dd);
+  activate_clusters(field, dp, dd, routeClusters);
+}
+
+IVec2 get_flow_dir(FlowField &field, const DungeonPortals &dp, const DungeonData &dd, IVec2 tile)
+{
+  const size_t cluster = get_flow_cluster(dp, dd, tile);
+  // field of older portals is stale until its target is set again
+  if (cluster == invalid_cluster || field.portalsVersion != dp.version)
+    return {0, 0};
+  // tiles cut off from the target never get a direction, there's no point in activating their clusters
+  if (!nav::are_tiles_connected(dp.components, {tile.x, tile.y}, {field.target.x, field.target.y}))
+    return {0, 0};
+  request_cluster(field, dp, dd, cluster);
+  const uint8_t dir = field.tileDir[size_t(tile.y) * dd.width + size_t(tile.x)];
+  return dir == no_flow_dir ? IVec2{0, 0} : flow_dirs[dir];
+}
+
+float get_flow_dist(FlowField &field, const DungeonPortals &dp, const DungeonData &dd, IVec2 tile)
+{
+  const size_t cluster = get_flow_cluster(dp, dd, tile);
+  if (cluster == invalid_cluster || field.portalsVersion != dp.version ||
+      !nav::are_tiles_connected(dp.components, {tile.x, tile.y}, {field.target.x, field.target.y}))
+    return nav::blocked_tile;
+  request_cluster(field, dp, dd, cluster);
+  return field.tileDist[size_t(tile.y) * dd.width + size_t(tile.x)] + field.distOffset;
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "math.h"
+#include "pathfinder.h"
+#include "openHeap.h"
+
+// Directions towards one target shared by every agent heading there. The integration field is a Dijkstra from
+// the target over tiles of active clusters only: the ones agents asked about plus the clusters the portal graph
+// routes them through. Clusters are added lazily and the field is extended from its border, not recomputed.
+// Distances are exact within the active clusters, a slightly shorter way through other clusters may be missed
+// when the portal graph underestimates it, so followed paths are near-optimal.
+struct FlowField
+{
+  IVec2 target{-1, -1};
+  uint32_t portalsVersion = 0;
+  float tileSize = 1.f; // world units per tile, agents sample the field at their positions
+  // Dijkstra from the target over the base portal graph, it's resumed until portals of the clusters asked about
+  // are settled, so far away parts of the map aren't searched
+  std::vector<float> portalDist;
+  std::vector<uint32_t> portalNext; // next portal on the way, invalid for the ones linked to the target
+  std::vector<uint32_t> portalCluster; // cluster the way from the portal goes through
+  std::vector<uint8_t> portalSettled;
+  // connected parts of the portal graph, portals outside the target's ones are never searched for
+  std::vector<uint32_t> portalComponent;
+  std::vector<uint32_t> targetComponents;
+  std::vector<uint32_t> portalVisit; // stamps of route walks, the routes form a tree and are walked once
+  uint32_t visitStamp = 0;
+  nav::OpenHeap portalOpen;
+  std::vector<uint8_t> clusterActive;
+  std::vector<size_t> activeClusters;
+  // clusters asked about since the target last moved, the field for the new target starts with them
+  std::vector<size_t> requestedClusters;
+  std::vector<uint8_t> clusterRequested;
+  std::vector<float> tileDist;
+  float distOffset = 0.f; // added to tileDist, shifts the whole field when the target moves
+  std::vector<uint8_t> tileDir;
+  size_t numSettled = 0; // tiles settled by the Dijkstra since creation
+};
+
+// Does nothing while the target stays on the same tile and the portals don't change. A moved target repairs the
+// field from the old one, only tiles which got closer are searched again. It's computed from scratch for the
+// clusters agents used since the previous move when the portals change or the old field doesn't reach the new target.
+void set_flow_field_target(FlowField &field, const DungeonPortals &dp, const DungeonData &dd, IVec2 target);
+// Step towards the target from the tile, {0, 0} at the target and where it can't be reached.
+IVec2 get_flow_dir(FlowField &field, const DungeonPortals &dp, const DungeonData &dd, IVec2 tile);
+float get_flow_dist(FlowField &field, const DungeonPortals &dp, const DungeonData &dd, IVec2 tile);
@@ -0,0 +1,202 @@
+#include "pathService.h"
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include "ecsTypes.h"
+#include "pathfinder.h"
+
+// Everything paths are searched over, workers keep it alive while they use it.
+struct PathSnapshot
+{
+  DungeonData dd;
+  DungeonPortals dp;
+};
+
+struct PathQueryKey
+{
+  IVec2 from, to;
+  uint32_t flags;
+};
+
+static bool operator==(const PathQueryKey &lhs, const PathQueryKey &rhs)
+{
+  return lhs.from == rhs.from && lhs.to == rhs.to && lhs.flags == rhs.flags;
+}
+
+struct PathQueryKeyHash
+{
+  size_t operator()(const PathQueryKey &key) const
+  {
+    size_t hash = 14695981039346656037ull;
+    for (int v : {key.from.x, key.from.y, key.to.x, key.to.y, int(key.flags)})
+      hash = (hash ^ uint32_t(v)) * 1099511628211ull;
+    return hash;
+  }
+};
+
+struct PathJob
+{
+  PathQueryKey key;
+  std::shared_ptr<const PathSnapshot> snapshot;
+};
+
+struct PathJobResult
+{
+  PathQueryKey key;
+  uint32_t portalsVersion;
+  Path path;
+};
+
+// Worker threads solving jobs in order of arrival, results are picked up by the game thread.
+class PathWorkers
+{
+  std::mutex mutex;
+  std::condition_variable hasJobs;
+  std::deque<PathJob> jobs;
+  std::deque<PathJobResult> results;
+  bool stopping = false;
+  std::vector<std::thread> workers; // started last, when everything they use is constructed
+
+  void run()
+  {
+    HierarchicalPathCache cache; // per worker, segments and portal paths are reused between its jobs
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true)
+    {
+      hasJobs.wait(lock, [&]() { return stopping || !jobs.empty(); });
+      if (stopping)
+        return;
+      PathJob job = std::move(jobs.front());
+      jobs.pop_front();
+      lock.unlock();
+      const PathSnapshot &snapshot = *job.snapshot;
+      PathJobResult res{job.key, snapshot.dp.version, {job.key.from, job.key.to, job.key.flags, {}, {}}};
+      Path &path = res.path;
+      if (job.key.flags & PQ_EXACT)
+        path.tiles = find_path_a_star(snapshot.dp, snapshot.dd, job.key.from, job.key.to);
+      else
+      {
+        const size_t segmentHits = cache.segmentHits, segmentMisses = cache.segmentMisses;
+        const size_t abstractHits = cache.abstractHits, abstractMisses = cache.abstractMisses;
+        path.tiles = find_hierarchical_path(snapshot.dp, snapshot.dd, job.key.from, job.key.to, cache, &path.stats);
+        path.segmentHits = cache.segmentHits - segmentHits;
+        path.segmentMisses = cache.segmentMisses - segmentMisses;
+        path.abstractHits = cache.abstractHits - abstractHits;
+        path.abstractMisses = cache.abstractMisses - abstractMisses;
+      }
+      job.snapshot.reset(); // the last copy of an outdated snapshot isn't freed under the lock
+      lock.lock();
+      results.emplace_back(std::move(res));
+    }
+  }
+public:
+  PathWorkers(size_t num_workers)
+  {
+    for (size_t i = 0; i < num_workers; ++i)
+      workers.emplace_back([this]() { run(); });
+  }
+  ~PathWorkers()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+    }
+    hasJobs.notify_all();
+    for (std::thread &worker : workers)
+      worker.join();
+  }
+
+  void submit(PathJob &&job)
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      jobs.emplace_back(std::move(job));
+    }
+    hasJobs.notify_one();
+  }
+
+  void collect(std::vector<PathJobResult> &out, size_t max_results)
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    const size_t count = std::min(max_results, results.size());
+    std::move(results.begin(), results.begin() + std::ptrdiff_t(count), std::back_inserter(out));
+    results.erase(results.begin(), results.begin() + std::ptrdiff_t(count));
+  }
+};
+
+static PathWorkers &get_path_workers()
+{
+  // one hardware thread is left to the game
+  static PathWorkers pathWorkers(std::max(size_t(std::thread::hardware_concurrency()), size_t(2)) - 1);
+  return pathWorkers;
+}
+
+// Game thread side: which entities wait for which query, so a query is sent to the workers only once.
+struct PathRequests
+{
+  std::shared_ptr<const PathSnapshot> snapshot;
+  std::unordered_map<PathQueryKey, std::vector<flecs::entity>, PathQueryKeyHash> waiting;
+  std::unordered_map<flecs::entity_t, PathQueryKey> posted;
+  std::vector<PathJobResult> results;
+};
+
+void register_path_service(flecs::world &ecs, size_t max_results_per_frame)
+{
+  static PathRequests requests;
+  static auto pathRequestQuery = ecs.query<const PathRequest>();
+
+  ecs.system<const DungeonPortals, const DungeonData>()
+    .each([&, max_results_per_frame](const DungeonPortals &dp, const DungeonData &dd)
+    {
+      PathWorkers &workers = get_path_workers();
+      requests.results.clear();
+      workers.collect(requests.results, max_results_per_frame);
+      for (PathJobResult &res : requests.results)
+      {
+        const auto itf = requests.waiting.find(res.key);
+        if (itf == requests.waiting.end())
+          continue;
+        const std::vector<flecs::entity> entities = std::move(itf->second);
+        requests.waiting.erase(itf);
+        for (flecs::entity e : entities)
+        {
+          const auto posted = requests.posted.find(e.id());
+          if (posted == requests.posted.end() || !(posted->second == res.key))
+            continue; // request was changed while this one was solved
+          requests.posted.erase(posted);
+          // solved for older portals, the request stays and is sent again below
+          if (res.portalsVersion != dp.version || !e.is_alive())
+            continue;
+          e.set(res.path);
+          e.remove<PathRequest>();
+        }
+      }
+
+      if (!requests.snapshot || requests.snapshot->dp.version != dp.version)
+        requests.snapshot = std::make_shared<const PathSnapshot>(PathSnapshot{dd, dp});
+      pathRequestQuery.each([&](flecs::entity e, const PathRequest &req)
+      {
+        const PathQueryKey key{req.from, req.to, req.flags};
+        const auto posted = requests.posted.find(e.id());
+        if (posted != requests.posted.end() && posted->second == key)
+          return; // still being solved
+        if (!nav::are_tiles_connected(dp.components, {key.from.x, key.from.y}, {key.to.x, key.to.y}))
+        {
+          // no need to wait for a worker to find out
+          requests.posted.erase(e.id());
+          e.set(Path{key.from, key.to, key.flags, {}, {}});
+          e.remove<PathRequest>();
+          return;
+        }
+        requests.posted[e.id()] = key;
+        std::vector<flecs::entity> &entities = requests.waiting[key];
+        entities.push_back(e);
+        if (entities.size() == 1)
+          workers.submit({key, requests.snapshot});
+      });
+    });
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <flecs.h>
+#include <cstdint>
+#include <vector>
+
+#include "math.h"
+#include "pathfinder.h"
+
+enum PathQueryFlags : uint32_t
+{
+  PQ_HIERARCHICAL = 0,
+  PQ_EXACT = 1 << 0, // A* over the whole map, optimal but slower
+};
+
+// Posted on an entity to get a Path, identical requests of different entities are solved once.
+struct PathRequest
+{
+  IVec2 from, to;
+  uint32_t flags = PQ_HIERARCHICAL;
+};
+
+// Replaces the request once it's solved.
+struct Path
+{
+  IVec2 from, to;
+  uint32_t flags;
+  std::vector<IVec2> tiles; // empty if `to` can't be reached
+  HierarchicalPathStats stats; // empty for exact paths
+  // lookups of the worker's cache made by this query
+  size_t segmentHits = 0, segmentMisses = 0;
+  size_t abstractHits = 0, abstractMisses = 0;
+};
+
+// Requests are solved by background workers against an immutable copy of the dungeon and its portals, taken when
+// the portals change. Results are written back by a system, at most max_results_per_frame of them per frame,
+// the rest wait for the next frames. Results for outdated portals are dropped and their requests sent again.
+// Requests between tiles which aren't connected get an empty path right away.
+void register_path_service(flecs::world &ecs, size_t max_results_per_frame = 32);
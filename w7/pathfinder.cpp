@@ -1,239 +1,261 @@
 #include "pathfinder.h"
+#include "portalHierarchy.h"
 #include "dungeonUtils.h"
 #include "math.h"
+#include "gridSearch.h"
+#include "gridFlood.h"
+#include "workStealing.h"
 #include <algorithm>
+#include <atomic>
+#include <limits>
 
-float heuristic(IVec2 lhs, IVec2 rhs)
-{
-  return sqrtf(sqr(float(lhs.x - rhs.x)) + sqr(float(lhs.y - rhs.y)));
-};
+static const nav::TileCosts tile_costs = nav::make_tile_costs({{dungeon::wall, nav::blocked_tile}});
 
-float portal_heuristic(const PathPortal& lhs, const PathPortal& rhs)
+std::vector<IVec2> find_path_a_star(const DungeonPortals &dp, const DungeonData &dd, IVec2 from, IVec2 to)
 {
-  IVec2 lhs_coord{static_cast<int>((lhs.startX + lhs.endX) / 2), static_cast<int>((lhs.startY + lhs.endY) / 2)};
-  IVec2 rhs_coord{static_cast<int>((rhs.startX + rhs.endX) / 2), static_cast<int>((rhs.startY + rhs.endY) / 2)};
-
-  return sqrtf(sqr(float(lhs_coord.x - rhs_coord.x)) + sqr(float(lhs_coord.y - rhs_coord.y)));
+  if (!nav::are_tiles_connected(dp.components, {from.x, from.y}, {to.x, to.y}))
+    return {};
+  const nav::GridMap map{dd.tiles.data(), dd.width, dd.height, &tile_costs};
+  const std::vector<size_t> tiles = nav::find_grid_path(map, {from.x, from.y}, {to.x, to.y},
+                                                        {0, 0, int(dd.width), int(dd.height)});
+  std::vector<IVec2> path;
+  path.reserve(tiles.size());
+  for (size_t tile : tiles)
+    path.push_back({int(tile % dd.width), int(tile / dd.width)});
+  return path;
 }
 
-template<typename T>
-static size_t coord_to_idx(T x, T y, size_t w)
+// Tiles of the portal which lie inside the cluster, portals span both clusters they connect.
+static std::vector<nav::GridPos> get_portal_tiles(const PathPortal &portal, IVec2 lim_min, IVec2 lim_max)
 {
-  return size_t(y) * w + size_t(x);
+  std::vector<nav::GridPos> tiles;
+  for (size_t y = std::max(portal.startY, size_t(lim_min.y)); y <= std::min(portal.endY, size_t(lim_max.y - 1)); ++y)
+    for (size_t x = std::max(portal.startX, size_t(lim_min.x)); x <= std::min(portal.endX, size_t(lim_max.x - 1)); ++x)
+      tiles.push_back({int(x), int(y)});
+  return tiles;
 }
 
-static size_t portal_to_idx(const PathPortal& p, size_t w)
+static void get_cluster_limits(const DungeonPortals &dp, IVec2 pos, IVec2 &lim_min, IVec2 &lim_max)
 {
-  return coord_to_idx(static_cast<int>((p.startX + p.endX) / 2), static_cast<int>((p.startY + p.endY) / 2), w);
+  const int split = int(dp.tileSplit);
+  lim_min = {pos.x / split * split, pos.y / split * split};
+  lim_max = {lim_min.x + split, lim_min.y + split};
 }
 
-static std::vector<IVec2> reconstruct_path(std::vector<IVec2> prev, IVec2 to, size_t width)
+// One flood from the query end over its cluster gives exact distances to every portal of the cluster at once.
+static std::vector<EndpointLink> link_to_cluster_portals(const DungeonData &dd, const DungeonPortals &dp, IVec2 pos,
+                                                         nav::GridFlood &flood)
 {
-  IVec2 curPos = to;
-  std::vector<IVec2> res = {curPos};
-  while (prev[coord_to_idx(curPos.x, curPos.y, width)] != IVec2{-1, -1})
+  const nav::GridMap map{dd.tiles.data(), dd.width, dd.height, &tile_costs};
+  IVec2 limMin, limMax;
+  get_cluster_limits(dp, pos, limMin, limMax);
+  nav::flood_grid(map, {{pos.x, pos.y}}, {limMin.x, limMin.y, limMax.x, limMax.y}, flood);
+  const size_t width = dd.width / dp.tileSplit;
+  std::vector<EndpointLink> links;
+  for (size_t idx : dp.tilePortalsIndices[size_t(limMin.y / int(dp.tileSplit)) * width + size_t(limMin.x / int(dp.tileSplit))])
   {
-    curPos = prev[coord_to_idx(curPos.x, curPos.y, width)];
-    res.insert(res.begin(), curPos);
+    float minDist = nav::blocked_tile;
+    for (const nav::GridPos &tile : get_portal_tiles(dp.portals[idx], limMin, limMax))
+      minDist = std::min(minDist, nav::get_flood_dist(flood, tile));
+    // scored like the cluster edges, in tiles including both ends
+    if (minDist != nav::blocked_tile)
+      links.push_back({idx, minDist + 1.f});
   }
-  return res;
+  return links;
 }
 
-static std::vector<IVec2> find_path_a_star(const DungeonData &dd, IVec2 from, IVec2 to,
-                                           IVec2 lim_min, IVec2 lim_max)
+static size_t get_pos_cluster(const DungeonPortals &dp, const DungeonData &dd, IVec2 pos)
 {
-  if (from.x < 0 || from.y < 0 || from.x >= int(dd.width) || from.y >= int(dd.height))
-    return std::vector<IVec2>();
-  size_t inpSize = dd.width * dd.height;
-
-  std::vector<float> g(inpSize, std::numeric_limits<float>::max());
-  std::vector<float> f(inpSize, std::numeric_limits<float>::max());
-  std::vector<IVec2> prev(inpSize, {-1,-1});
+  return size_t(pos.y) / dp.tileSplit * (dd.width / dp.tileSplit) + size_t(pos.x) / dp.tileSplit;
+}
 
-  auto getG = [&](IVec2 p) -> float { return g[coord_to_idx(p.x, p.y, dd.width)]; };
-  auto getF = [&](IVec2 p) -> float { return f[coord_to_idx(p.x, p.y, dd.width)]; };
+static void sync_path_cache(const DungeonPortals &dp, HierarchicalPathCache &cache)
+{
+  if (cache.portalsVersion == dp.version)
+    return;
+  // portal indices and tiles behind them may have changed, nothing cached can be trusted
+  cache.portalsVersion = dp.version;
+  cache.segments.clear();
+  cache.abstractPaths.clear();
+  cache.abstractPathIndices.clear();
+}
 
-  g[coord_to_idx(from.x, from.y, dd.width)] = 0;
-  f[coord_to_idx(from.x, from.y, dd.width)] = heuristic(from, to);
+static bool has_link(const std::vector<EndpointLink> &links, size_t portal)
+{
+  return std::any_of(links.begin(), links.end(), [&](const EndpointLink &link) { return link.portal == portal; });
+}
 
-  std::vector<IVec2> openList = {from};
-  std::vector<IVec2> closedList;
+bool make_hierarchical_path(const DungeonPortals &dp, const DungeonData &dd, IVec2 from, IVec2 to,
+                            HierarchicalPathCache &cache, HierarchicalPath &path, HierarchicalPathStats *stats)
+{
+  sync_path_cache(dp, cache);
+  if (stats)
+    *stats = {};
+  path = {from, to, dp.version, {}, {}, 0, {}};
+  // a sealed off goal would make both floods and the portal search go through everything reachable
+  if (!nav::are_tiles_connected(dp.components, {from.x, from.y}, {to.x, to.y}))
+    return false;
+  const size_t fromCluster = get_pos_cluster(dp, dd, from);
+  const size_t toCluster = get_pos_cluster(dp, dd, to);
+
+  thread_local nav::GridFlood fromFlood;
+  thread_local nav::GridFlood toFlood;
+  const std::vector<EndpointLink> fromLinks = link_to_cluster_portals(dd, dp, from, fromFlood);
+  if (fromCluster == toCluster && nav::get_flood_dist(fromFlood, {to.x, to.y}) != nav::blocked_tile)
+  {
+    path.clusters = {fromCluster};
+    return true;
+  }
+  // the way around may still lead through other clusters
+  const std::vector<EndpointLink> toLinks = link_to_cluster_portals(dd, dp, to, toFlood);
 
-  while (!openList.empty())
+  const uint64_t key = uint64_t(fromCluster) << 32 | uint64_t(toCluster);
+  const auto itf = cache.abstractPathIndices.find(key);
+  if (itf != cache.abstractPathIndices.end())
   {
-    size_t bestIdx = 0;
-    float bestScore = getF(openList[0]);
-    for (size_t i = 1; i < openList.size(); ++i)
+    const AbstractPath &cached = *itf->second;
+    // other tiles of the same clusters may be cut off from the portals the cached path starts or ends with
+    if (has_link(fromLinks, cached.portals.front()) && has_link(toLinks, cached.portals.back()))
     {
-      float score = getF(openList[i]);
-      if (score < bestScore)
-      {
-        bestIdx = i;
-        bestScore = score;
-      }
+      cache.abstractHits++;
+      cache.abstractPaths.splice(cache.abstractPaths.begin(), cache.abstractPaths, itf->second);
+      path.portals = cached.portals;
+      path.clusters = cached.clusters;
+      return true;
     }
-    if (openList[bestIdx] == to)
-      return reconstruct_path(prev, to, dd.width);
-    IVec2 curPos = openList[bestIdx];
-    openList.erase(openList.begin() + bestIdx);
-    if (std::find(closedList.begin(), closedList.end(), curPos) != closedList.end())
-      continue;
-    size_t idx = coord_to_idx(curPos.x, curPos.y, dd.width);
-    closedList.emplace_back(curPos);
-    auto checkNeighbour = [&](IVec2 p)
-    {
-      // out of bounds
-      if (p.x < lim_min.x || p.y < lim_min.y || p.x >= lim_max.x || p.y >= lim_max.y)
-        return;
-      size_t idx = coord_to_idx(p.x, p.y, dd.width);
-      // not empty
-      if (dd.tiles[idx] == dungeon::wall)
-        return;
-      float edgeWeight = 1.f;
-      float gScore = getG(curPos) + 1.f * edgeWeight; // we're exactly 1 unit away
-      if (gScore < getG(p))
-      {
-        prev[idx] = curPos;
-        g[idx] = gScore;
-        f[idx] = gScore + heuristic(p, to);
-      }
-      bool found = std::find(openList.begin(), openList.end(), p) != openList.end();
-      if (!found)
-        openList.emplace_back(p);
-    };
-    checkNeighbour({curPos.x + 1, curPos.y + 0});
-    checkNeighbour({curPos.x - 1, curPos.y + 0});
-    checkNeighbour({curPos.x + 0, curPos.y + 1});
-    checkNeighbour({curPos.x + 0, curPos.y - 1});
+    cache.abstractPaths.erase(itf->second);
+    cache.abstractPathIndices.erase(itf);
+  }
+  cache.abstractMisses++;
+  path.portals = find_portal_path(dp, dd, from, fromLinks, to, toLinks, path.clusters, stats);
+  if (path.portals.empty())
+    return false;
+  cache.abstractPaths.push_front({key, path.portals, path.clusters});
+  cache.abstractPathIndices[key] = cache.abstractPaths.begin();
+  if (cache.abstractPaths.size() > cache.abstractPathsCapacity)
+  {
+    cache.abstractPathIndices.erase(cache.abstractPaths.back().key);
+    cache.abstractPaths.pop_back();
   }
-  // empty path
-  return std::vector<IVec2>();
+  return true;
 }
 
-static std::vector<IVec2> find_path_a_star_portal(const DungeonData &dd, const DungeonPortals &dp,
-                                                  PathPortal from, PathPortal to)
+// Tiles inside the cluster from the closest of the sources to the closest of the targets.
+static std::vector<IVec2> find_cluster_segment(const DungeonData &dd, IVec2 lim_min, IVec2 lim_max,
+                                               const std::vector<nav::GridPos> &sources,
+                                               const std::vector<nav::GridPos> &targets)
 {
-  size_t inpSize = dd.width * dd.height;
-
-  std::vector<float> g(inpSize, std::numeric_limits<float>::max());
-  std::vector<IVec2> prev(inpSize, {-1, -1});
-
-  auto getG = [&](const PathPortal& p) -> float { return g[portal_to_idx(p, dd.width)]; };
-  auto getF = [&](const PathPortal& p) -> float { return getG(p) + portal_heuristic(p, to); };
-
-  g[coord_to_idx(static_cast<int>((from.startX + from.endX) / 2), static_cast<int>((from.startY + from.endY) / 2), dd.width)] = 0;
-
-  std::vector<PathPortal> openList = {from};
-  std::vector<PathPortal> closedList;
+  const nav::GridMap map{dd.tiles.data(), dd.width, dd.height, &tile_costs};
+  thread_local nav::GridFlood flood;
+  nav::flood_grid(map, sources, {lim_min.x, lim_min.y, lim_max.x, lim_max.y}, flood);
+  const auto closest = std::min_element(targets.begin(), targets.end(), [&](const nav::GridPos &lhs, const nav::GridPos &rhs)
+  {
+    return nav::get_flood_dist(flood, lhs) < nav::get_flood_dist(flood, rhs);
+  });
+  std::vector<IVec2> segment;
+  if (closest == targets.end())
+    return segment;
+  for (const nav::GridPos &tile : nav::trace_flood_path(map, flood, *closest))
+    segment.push_back({tile.x, tile.y});
+  return segment;
+}
 
-  while (!openList.empty())
+// Steps from the end of the previous segment to the start of the next one: across the portal, then along it.
+static void append_portal_crossing(std::vector<IVec2> &tiles, IVec2 to, bool cross_x)
+{
+  IVec2 cur = tiles.back();
+  auto walk = [&](int &coord, int target)
   {
-    size_t bestIdx = 0;
-    float bestScore = getF(openList[0]);
-    for (size_t i = 1; i < openList.size(); ++i)
-    {
-      float score = getF(openList[i]);
-      if (score < bestScore)
-      {
-        bestIdx = i;
-        bestScore = score;
-      }
-    }
-    if (openList[bestIdx] == to)
+    while (coord != target)
     {
-      IVec2 to_coord = {static_cast<int>((to.startX + to.endX) / 2), static_cast<int>((to.startY + to.endY) / 2)};
-      return reconstruct_path(prev, to_coord, dd.width);
+      coord += target > coord ? 1 : -1;
+      if (cur != to)
+        tiles.push_back(cur);
     }
-    const auto curPortal = openList[bestIdx];
-    openList.erase(openList.begin() + bestIdx);
-    if (std::find(closedList.begin(), closedList.end(), curPortal) != closedList.end())
-      continue;
-    closedList.emplace_back(curPortal);
-
-    auto checkNeighbour = [&](const PathPortal& p, float edgeWeight) {
-      size_t idx = portal_to_idx(p, dd.width);
-      float gScore = getG(curPortal) + 1.f * edgeWeight;
-      if (gScore < getG(p)) {
-        prev[idx] = {static_cast<int>((curPortal.startX + curPortal.endX) / 2), static_cast<int>((curPortal.startY + curPortal.endY) / 2)};
-        g[idx] = gScore;
-      }
-      bool found = std::find(openList.begin(), openList.end(), p) != openList.end();
-      if (!found)
-        openList.emplace_back(p);
-    };
-
-    for (auto c : curPortal.conns)
-      checkNeighbour(dp.portals[c.connIdx], c.score);
+  };
+  if (cross_x)
+  {
+    walk(cur.x, to.x);
+    walk(cur.y, to.y);
+  }
+  else
+  {
+    walk(cur.y, to.y);
+    walk(cur.x, to.x);
   }
-  return {};
 }
 
-static std::vector<IVec2> get_shortest_path_portal(const DungeonData &dd, const DungeonPortals &dp,
-                                            IVec2 from, IVec2 tile, PathPortal &p)
+static void refine_next_segment(const DungeonPortals &dp, const DungeonData &dd, HierarchicalPathCache &cache,
+                                HierarchicalPath &path)
 {
-  auto shortestPath = std::vector<IVec2>();
-  const auto width = dd.width / dp.tileSplit;
-
-  for (const auto portal_ind : dp.tilePortalsIndices[tile.y * width + tile.x])
+  const size_t idx = path.numRefined++;
+  const size_t cluster = path.clusters[idx];
+  const size_t width = dd.width / dp.tileSplit;
+  const int split = int(dp.tileSplit);
+  const IVec2 limMin{int(cluster % width) * split, int(cluster / width) * split};
+  const IVec2 limMax{limMin.x + split, limMin.y + split};
+  const bool first = idx == 0;
+  const bool last = idx == path.portals.size();
+  const std::vector<nav::GridPos> sources = first ? std::vector<nav::GridPos>{{path.from.x, path.from.y}}
+                                                  : get_portal_tiles(dp.portals[path.portals[idx - 1]], limMin, limMax);
+  const std::vector<nav::GridPos> targets = last ? std::vector<nav::GridPos>{{path.to.x, path.to.y}}
+                                                 : get_portal_tiles(dp.portals[path.portals[idx]], limMin, limMax);
+  std::vector<IVec2> segment;
+  if (first || last)
+    segment = find_cluster_segment(dd, limMin, limMax, sources, targets);
+  else
   {
-    IVec2 limMin{static_cast<int>(tile.x * dp.tileSplit), static_cast<int>(tile.y * dp.tileSplit)};
-    IVec2 limMax{static_cast<int>((tile.x + 1) * dp.tileSplit), static_cast<int>((tile.y + 1) * dp.tileSplit)};
-
-    bool noPath = false;
-    const auto portal = dp.portals[portal_ind];
-    auto path = std::vector<IVec2>();
-    for (size_t toY = std::max(portal.startY, size_t(limMin.y));
-         toY <= std::min(portal.endY, size_t(limMax.y - 1)) && !noPath; ++toY)
-    {
-      for (size_t toX = std::max(portal.startX, size_t(limMin.x));
-           toX <= std::min(portal.endX, size_t(limMax.x - 1)) && !noPath; ++toX)
-      {
-        IVec2 to{int(toX), int(toY)};
-        std::vector<IVec2> curPath = find_path_a_star(dd, from, to, limMin, limMax);
-        if (curPath.empty() && from != to)
-        {
-          noPath = true;
-          break;
-        }
-        if (path.empty() || curPath.size() < path.size())
-          path = std::move(curPath);
-      }
-    }
-
-    if (shortestPath.empty() || path.size() < shortestPath.size())
+    // between two portals the segment doesn't depend on the query ends
+    const PathSegmentKey key{cluster, path.portals[idx - 1], path.portals[idx]};
+    auto itf = cache.segments.find(key);
+    if (itf == cache.segments.end())
     {
-      shortestPath = std::move(path);
-      p = dp.portals[portal_ind];
+      cache.segmentMisses++;
+      itf = cache.segments.emplace(key, find_cluster_segment(dd, limMin, limMax, sources, targets)).first;
     }
+    else
+      cache.segmentHits++;
+    segment = itf->second;
   }
-  return shortestPath;
+  if (segment.empty())
+    return;
+  if (!path.tiles.empty())
+  {
+    // neighbouring clusters in a row share a vertical border, which is crossed along x
+    append_portal_crossing(path.tiles, segment.front(), path.clusters[idx - 1] / width == cluster / width);
+    if (path.tiles.back() == segment.front())
+      segment.erase(segment.begin());
+  }
+  path.tiles.insert(path.tiles.end(), segment.begin(), segment.end());
 }
 
-std::vector<IVec2> find_hierarchical_path(const DungeonPortals &dp, const DungeonData &dd,
-                                          IVec2 from, IVec2 to)
+bool refine_hierarchical_path(const DungeonPortals &dp, const DungeonData &dd, HierarchicalPathCache &cache,
+                              HierarchicalPath &path, size_t tile_idx)
 {
-  const IVec2 fromTile{static_cast<int>(from.x / dp.tileSplit), static_cast<int>(from.y / dp.tileSplit)};
-  const IVec2 toTile{static_cast<int>(to.x / dp.tileSplit), static_cast<int>(to.y / dp.tileSplit)};
+  // portals are renumbered by updates, old indices may point at other portals or past the end
+  if (path.portalsVersion != dp.version)
+    return false;
+  sync_path_cache(dp, cache);
+  while (!is_hierarchical_path_refined(path) && path.tiles.size() <= tile_idx)
+    refine_next_segment(dp, dd, cache, path);
+  return true;
+}
 
-  if (fromTile == toTile)
-  {
-    IVec2 limMin{static_cast<int>(fromTile.x * dp.tileSplit), static_cast<int>(fromTile.y * dp.tileSplit)};
-    IVec2 limMax{static_cast<int>((fromTile.x + 1) * dp.tileSplit), static_cast<int>((fromTile.y + 1) * dp.tileSplit)};
-    return find_path_a_star(dd, from, to, limMin, limMax);
-  }
+std::vector<IVec2> find_hierarchical_path(const DungeonPortals &dp, const DungeonData &dd, IVec2 from, IVec2 to,
+                                          HierarchicalPathCache &cache, HierarchicalPathStats *stats)
+{
+  HierarchicalPath path;
+  if (!make_hierarchical_path(dp, dd, from, to, cache, path, stats))
+    return {};
+  refine_hierarchical_path(dp, dd, cache, path, std::numeric_limits<size_t>::max());
+  return std::move(path.tiles);
+}
 
-  auto fromPortal = PathPortal();
-  auto toPortal = PathPortal();
-  const auto fromStartToClosest = get_shortest_path_portal(dd, dp, from, fromTile, fromPortal);
-  const auto fromTargetToClosest = get_shortest_path_portal(dd, dp, to, toTile, toPortal);
-  const auto fromStartToTarget = find_path_a_star_portal(dd, dp, fromPortal, toPortal);
-
-  auto resPath = std::vector<IVec2>();
-  resPath.reserve(fromStartToClosest.size() + fromStartToTarget.size() + fromTargetToClosest.size());
-  resPath.insert(resPath.end(), fromStartToClosest.begin(), fromStartToClosest.end());
-  resPath.insert(resPath.end(), fromStartToTarget.begin(), fromStartToTarget.end());
-  resPath.insert(resPath.end(), fromTargetToClosest.begin(), fromTargetToClosest.end());
-  return resPath;
+std::vector<IVec2> find_hierarchical_path(const DungeonPortals &dp, const DungeonData &dd, IVec2 from, IVec2 to,
+                                          HierarchicalPathStats *stats)
+{
+  HierarchicalPathCache cache;
+  return find_hierarchical_path(dp, dd, from, to, cache, stats);
 }
 
 void draw_path(const std::vector<IVec2>& path, float tile_size)
@@ -256,144 +278,241 @@ void draw_path(const std::vector<IVec2>& path, float tile_size)
   DrawRectangleRec({path[path.size() - 1].x * tile_size, path[path.size() - 1].y * tile_size, tile_size, tile_size}, pathColor);
 }
 
+// Portals on the top and left borders of cluster (xx, yy), each of them is shared with the neighbouring cluster.
+static void check_border(const DungeonData &dd, size_t splitTiles,
+                         size_t xx, size_t yy,
+                         size_t dir_x, size_t dir_y,
+                         int offs_x, int offs_y,
+                         std::vector<PathPortal> &portals)
+{
+  int spanFrom = -1;
+  int spanTo = -1;
+  for (size_t i = 0; i < splitTiles; ++i)
+  {
+    size_t x = xx * splitTiles + i * dir_x;
+    size_t y = yy * splitTiles + i * dir_y;
+    size_t nx = x + offs_x;
+    size_t ny = y + offs_y;
+    if (dd.tiles[y * dd.width + x] != dungeon::wall &&
+        dd.tiles[ny * dd.width + nx] != dungeon::wall)
+    {
+      if (spanFrom < 0)
+        spanFrom = i;
+      spanTo = i;
+    }
+    else if (spanFrom >= 0)
+    {
+      // write span
+      portals.push_back({xx * splitTiles + spanFrom * dir_x + offs_x,
+                         yy * splitTiles + spanFrom * dir_y + offs_y,
+                         xx * splitTiles + spanTo * dir_x,
+                         yy * splitTiles + spanTo * dir_y});
+      spanFrom = -1;
+    }
+  }
+  if (spanFrom >= 0)
+  {
+    portals.push_back({xx * splitTiles + spanFrom * dir_x + offs_x,
+                       yy * splitTiles + spanFrom * dir_y + offs_y,
+                       xx * splitTiles + spanTo * dir_x,
+                       yy * splitTiles + spanTo * dir_y});
+  }
+}
+
+static ClusterBorders find_cluster_borders(const DungeonData &dd, size_t split_tiles, size_t x, size_t y)
+{
+  ClusterBorders res;
+  // check top
+  if (y > 0)
+    check_border(dd, split_tiles, x, y, 1, 0, 0, -1, res.topPortals);
+  // left
+  if (x > 0)
+    check_border(dd, split_tiles, x, y, 0, 1, -1, 0, res.leftPortals);
+  return res;
+}
+
+// Connections between every pair of portals of the cluster, in the order they are added to the portals.
+// Portals are referred by their position in the cluster's list, which only depends on the cluster's borders.
+static std::vector<ClusterEdge> find_cluster_edges(const DungeonData &dd, const std::vector<PathPortal> &portals,
+                                                   const std::vector<size_t> &indices, size_t split_tiles, size_t x, size_t y)
+{
+  const nav::GridMap map{dd.tiles.data(), dd.width, dd.height, &tile_costs};
+  thread_local nav::GridFlood flood;
+  IVec2 limMin{int((x + 0) * split_tiles), int((y + 0) * split_tiles)};
+  IVec2 limMax{int((x + 1) * split_tiles), int((y + 1) * split_tiles)};
+  std::vector<ClusterEdge> edges;
+  for (size_t i = 0; i < indices.size(); ++i)
+  {
+    // one flood from the whole portal gives the closest distance to every tile of the cluster,
+    // portal tiles are a connected span, so reaching any tile of the other portal means reaching all of them
+    nav::flood_grid(map, get_portal_tiles(portals[indices[i]], limMin, limMax), {limMin.x, limMin.y, limMax.x, limMax.y}, flood);
+    for (size_t j = i + 1; j < indices.size(); ++j)
+    {
+      float minDist = nav::blocked_tile;
+      for (const nav::GridPos &tile : get_portal_tiles(portals[indices[j]], limMin, limMax))
+        minDist = std::min(minDist, nav::get_flood_dist(flood, tile));
+      // score is the length of the path in tiles, including both ends
+      if (minDist != nav::blocked_tile)
+        edges.push_back({i, j, minDist + 1.f});
+    }
+  }
+  return edges;
+}
+
+// Portal list of every cluster: its own top and left portals, then the ones owned by the right and bottom neighbours.
+static void merge_cluster_portals(DungeonPortals &dp, size_t width)
+{
+  const size_t numClusters = dp.clusterBorders.size();
+  dp.portals.clear();
+  dp.tilePortalsIndices.resize(numClusters);
+  for (std::vector<size_t> &indices : dp.tilePortalsIndices)
+    indices.clear();
+  auto push_portals = [&](size_t tidx, size_t neighbour_tidx, const std::vector<PathPortal> &new_portals)
+  {
+    for (const PathPortal &portal : new_portals)
+    {
+      dp.tilePortalsIndices[tidx].push_back(dp.portals.size());
+      dp.tilePortalsIndices[neighbour_tidx].push_back(dp.portals.size());
+      dp.portals.push_back(portal);
+    }
+  };
+  for (size_t tidx = 0; tidx < numClusters; ++tidx)
+  {
+    push_portals(tidx, tidx - width, dp.clusterBorders[tidx].topPortals);
+    push_portals(tidx, tidx - 1, dp.clusterBorders[tidx].leftPortals);
+  }
+}
+
+void build_portal_graph(PortalGraph &graph, size_t num_portals, const std::vector<std::vector<size_t>> &cluster_portals,
+                        const std::vector<std::vector<ClusterEdge>> &cluster_edges)
+{
+  graph.offsets.assign(num_portals + 1, 0);
+  for (size_t cluster = 0; cluster < cluster_edges.size(); ++cluster)
+    for (const ClusterEdge &edge : cluster_edges[cluster])
+    {
+      graph.offsets[cluster_portals[cluster][edge.from] + 1]++;
+      graph.offsets[cluster_portals[cluster][edge.to] + 1]++;
+    }
+  for (size_t i = 0; i < num_portals; ++i)
+    graph.offsets[i + 1] += graph.offsets[i];
+  graph.neighbours.resize(graph.offsets.back());
+  graph.costs.resize(graph.offsets.back());
+  graph.clusters.resize(graph.offsets.back());
+  std::vector<uint32_t> cursor(graph.offsets.begin(), graph.offsets.end() - 1);
+  auto add_conn = [&](size_t from, size_t to, float cost, size_t cluster)
+  {
+    const uint32_t conn = cursor[from]++;
+    graph.neighbours[conn] = uint32_t(to);
+    graph.costs[conn] = cost;
+    graph.clusters[conn] = uint32_t(cluster);
+  };
+  for (size_t cluster = 0; cluster < cluster_edges.size(); ++cluster)
+  {
+    const std::vector<size_t> &portals = cluster_portals[cluster];
+    for (const ClusterEdge &edge : cluster_edges[cluster])
+    {
+      add_conn(portals[edge.from], portals[edge.to], edge.score, cluster);
+      add_conn(portals[edge.to], portals[edge.from], edge.score, cluster);
+    }
+  }
+}
+
+static void update_cluster_edges(DungeonPortals &dp, const DungeonData &dd, const std::vector<size_t> &clusters,
+                                 size_t num_threads)
+{
+  const size_t width = dd.width / dp.tileSplit;
+  nav::parallel_for(clusters.size(), num_threads, [&](size_t i)
+  {
+    const size_t tidx = clusters[i];
+    dp.clusterEdges[tidx] = find_cluster_edges(dd, dp.portals, dp.tilePortalsIndices[tidx], dp.tileSplit,
+                                               tidx % width, tidx / width);
+  });
+}
+
+static uint32_t next_portals_version()
+{
+  static std::atomic<uint32_t> version = 0;
+  return ++version;
+}
+
+DungeonPortals build_dungeon_portals(const DungeonData &dd, const std::vector<size_t> &level_tiles, size_t num_threads)
+{
+  DungeonPortals dp = build_dungeon_portals(dd, level_tiles.front(), num_threads);
+  build_portal_levels(dp, dd, level_tiles, num_threads);
+  dp.version = next_portals_version();
+  return dp;
+}
+
+DungeonPortals build_dungeon_portals(const DungeonData &dd, size_t split_tiles, size_t num_threads)
+{
+  // go through each super tile
+  const size_t width = dd.width / split_tiles;
+  const size_t height = dd.height / split_tiles;
+  const size_t numClusters = width * height;
+
+  // clusters are processed in parallel and merged in cluster order, so the graph doesn't depend on scheduling
+  DungeonPortals dp{split_tiles, {}, {}, std::vector<ClusterBorders>(numClusters), std::vector<std::vector<ClusterEdge>>(numClusters), {}, {}, 0, {}};
+  nav::parallel_for(numClusters, num_threads, [&](size_t tidx)
+  {
+    dp.clusterBorders[tidx] = find_cluster_borders(dd, split_tiles, tidx % width, tidx / width);
+  });
+  merge_cluster_portals(dp, width);
+
+  std::vector<size_t> clusters(numClusters);
+  for (size_t tidx = 0; tidx < numClusters; ++tidx)
+    clusters[tidx] = tidx;
+  update_cluster_edges(dp, dd, clusters, num_threads);
+  build_portal_graph(dp.graph, dp.portals.size(), dp.tilePortalsIndices, dp.clusterEdges);
+  nav::build_grid_components({dd.tiles.data(), dd.width, dd.height, &tile_costs}, dp.components);
+  dp.version = next_portals_version();
+  return dp;
+}
+
+void update_dungeon_portals(DungeonPortals &dp, const DungeonData &dd, IVec2 dirty_min, IVec2 dirty_max, size_t num_threads)
+{
+  // tiles past the last whole cluster aren't a part of any cluster, but they still connect components
+  nav::update_grid_components({dd.tiles.data(), dd.width, dd.height, &tile_costs},
+                              {dirty_min.x, dirty_min.y, dirty_max.x, dirty_max.y}, dp.components);
+  const int width = int(dd.width / dp.tileSplit);
+  const int height = int(dd.height / dp.tileSplit);
+  const int split = int(dp.tileSplit);
+  const int minX = std::max(dirty_min.x, 0) / split;
+  const int minY = std::max(dirty_min.y, 0) / split;
+  const int maxX = std::min((dirty_max.x - 1) / split, width - 1);
+  const int maxY = std::min((dirty_max.y - 1) / split, height - 1);
+  if (dirty_max.x <= dirty_min.x || dirty_max.y <= dirty_min.y || minX > maxX || minY > maxY)
+    return;
+
+  // every border of a touched cluster can change, right and bottom ones belong to the neighbours
+  for (int y = minY; y <= std::min(maxY + 1, height - 1); ++y)
+    for (int x = minX; x <= std::min(maxX + 1, width - 1); ++x)
+      if (x <= maxX || y <= maxY)
+        dp.clusterBorders[size_t(y * width + x)] = find_cluster_borders(dd, dp.tileSplit, size_t(x), size_t(y));
+  merge_cluster_portals(dp, size_t(width));
+
+  // touched clusters changed inside, their side neighbours got new portals on the shared border
+  std::vector<size_t> clusters;
+  for (int y = std::max(minY - 1, 0); y <= std::min(maxY + 1, height - 1); ++y)
+    for (int x = std::max(minX - 1, 0); x <= std::min(maxX + 1, width - 1); ++x)
+      if ((x >= minX && x <= maxX) || (y >= minY && y <= maxY))
+        clusters.push_back(size_t(y * width + x));
+  update_cluster_edges(dp, dd, clusters, num_threads);
+  build_portal_graph(dp.graph, dp.portals.size(), dp.tilePortalsIndices, dp.clusterEdges);
+  update_portal_levels(dp, dd, clusters, num_threads);
+  dp.version = next_portals_version();
+}
+
 void prebuild_map(flecs::world &ecs)
 {
   auto mapQuery = ecs.query<const DungeonData>();
 
-  constexpr size_t splitTiles = 10;
+  // cluster sizes of every level, the finest first
+  const std::vector<size_t> levelTiles = {10, 20};
   ecs.defer([&]()
   {
     mapQuery.each([&](flecs::entity e, const DungeonData &dd)
     {
-      // go through each super tile
-      const size_t width = dd.width / splitTiles;
-      const size_t height = dd.height / splitTiles;
-
-      auto check_border = [&](size_t xx, size_t yy,
-                              size_t dir_x, size_t dir_y,
-                              int offs_x, int offs_y,
-                              std::vector<PathPortal> &portals)
-      {
-        int spanFrom = -1;
-        int spanTo = -1;
-        for (size_t i = 0; i < splitTiles; ++i)
-        {
-          size_t x = xx * splitTiles + i * dir_x;
-          size_t y = yy * splitTiles + i * dir_y;
-          size_t nx = x + offs_x;
-          size_t ny = y + offs_y;
-          if (dd.tiles[y * dd.width + x] != dungeon::wall &&
-              dd.tiles[ny * dd.width + nx] != dungeon::wall)
-          {
-            if (spanFrom < 0)
-              spanFrom = i;
-            spanTo = i;
-          }
-          else if (spanFrom >= 0)
-          {
-            // write span
-            portals.push_back({xx * splitTiles + spanFrom * dir_x + offs_x,
-                               yy * splitTiles + spanFrom * dir_y + offs_y,
-                               xx * splitTiles + spanTo * dir_x,
-                               yy * splitTiles + spanTo * dir_y});
-            spanFrom = -1;
-          }
-        }
-        if (spanFrom >= 0)
-        {
-          portals.push_back({xx * splitTiles + spanFrom * dir_x + offs_x,
-                             yy * splitTiles + spanFrom * dir_y + offs_y,
-                             xx * splitTiles + spanTo * dir_x,
-                             yy * splitTiles + spanTo * dir_y});
-        }
-      };
-
-      std::vector<PathPortal> portals;
-      std::vector<std::vector<size_t>> tilePortalsIndices;
-
-      auto push_portals = [&](size_t x, size_t y,
-                              int offs_x, int offs_y,
-                              const std::vector<PathPortal> &new_portals)
-      {
-        for (const PathPortal &portal : new_portals)
-        {
-          size_t idx = portals.size();
-          portals.push_back(portal);
-          tilePortalsIndices[y * width + x].push_back(idx);
-          tilePortalsIndices[(y + offs_y) * width + x + offs_x].push_back(idx);
-        }
-      };
-      for (size_t y = 0; y < height; ++y)
-        for (size_t x = 0; x < width; ++x)
-        {
-          tilePortalsIndices.push_back(std::vector<size_t>{});
-          // check top
-          if (y > 0)
-          {
-            std::vector<PathPortal> topPortals;
-            check_border(x, y, 1, 0, 0, -1, topPortals);
-            push_portals(x, y, 0, -1, topPortals);
-          }
-          // left
-          if (x > 0)
-          {
-            std::vector<PathPortal> leftPortals;
-            check_border(x, y, 0, 1, -1, 0, leftPortals);
-            push_portals(x, y, -1, 0, leftPortals);
-          }
-        }
-      for (size_t tidx = 0; tidx < tilePortalsIndices.size(); ++tidx)
-      {
-        const std::vector<size_t> &indices = tilePortalsIndices[tidx];
-        size_t x = tidx % width;
-        size_t y = tidx / width;
-        IVec2 limMin{int((x + 0) * splitTiles), int((y + 0) * splitTiles)};
-        IVec2 limMax{int((x + 1) * splitTiles), int((y + 1) * splitTiles)};
-        for (size_t i = 0; i < indices.size(); ++i)
-        {
-          PathPortal &firstPortal = portals[indices[i]];
-          for (size_t j = i + 1; j < indices.size(); ++j)
-          {
-            PathPortal &secondPortal = portals[indices[j]];
-            // check path from i to j
-            // check each position (to find closest dist) (could be made more optimal)
-            bool noPath = false;
-            size_t minDist = 0xffffffff;
-            for (size_t fromY = std::max(firstPortal.startY, size_t(limMin.y));
-                        fromY <= std::min(firstPortal.endY, size_t(limMax.y - 1)) && !noPath; ++fromY)
-            {
-              for (size_t fromX = std::max(firstPortal.startX, size_t(limMin.x));
-                          fromX <= std::min(firstPortal.endX, size_t(limMax.x - 1)) && !noPath; ++fromX)
-              {
-                for (size_t toY = std::max(secondPortal.startY, size_t(limMin.y));
-                            toY <= std::min(secondPortal.endY, size_t(limMax.y - 1)) && !noPath; ++toY)
-                {
-                  for (size_t toX = std::max(secondPortal.startX, size_t(limMin.x));
-                              toX <= std::min(secondPortal.endX, size_t(limMax.x - 1)) && !noPath; ++toX)
-                  {
-                    IVec2 from{int(fromX), int(fromY)};
-                    IVec2 to{int(toX), int(toY)};
-                    std::vector<IVec2> path = find_path_a_star(dd, from, to, limMin, limMax);
-                    if (path.empty() && from != to)
-                    {
-                      noPath = true; // if we found that there's no path at all - we can break out
-                      break;
-                    }
-                    minDist = std::min(minDist, path.size());
-                  }
-                }
-              }
-            }
-            // write pathable data and length
-            if (noPath)
-              continue;
-            firstPortal.conns.push_back({indices[j], float(minDist)});
-            secondPortal.conns.push_back({indices[i], float(minDist)});
-          }
-        }
-      }
-      e.set(DungeonPortals{splitTiles, portals, tilePortalsIndices});
+      e.set(build_dungeon_portals(dd, levelTiles));
     });
   });
 }
-
@@ -1,22 +1,19 @@
 #pragma once
 #include <flecs.h>
+#include <cstdint>
+#include <list>
+#include <unordered_map>
 #include <vector>
 
 #include <raylib.h>
 #include "math.h"
 #include "ecsTypes.h"
-
-struct PortalConnection
-{
-  size_t connIdx;
-  float score;
-};
+#include "gridComponents.h"
 
 struct PathPortal
 {
   size_t startX, startY;
   size_t endX, endY;
-  std::vector<PortalConnection> conns;
 };
 
 inline bool operator==(const PathPortal& lhs, const PathPortal& rhs)
@@ -24,13 +21,134 @@ inline bool operator==(const PathPortal& lhs, const PathPortal& rhs)
   return lhs.startX == rhs.startX && lhs.startY == rhs.startY && lhs.endX == rhs.endX && lhs.endY == rhs.endY;
 }
 
+struct ClusterBorders
+{
+  std::vector<PathPortal> topPortals;
+  std::vector<PathPortal> leftPortals;
+};
+
+struct ClusterEdge
+{
+  size_t from, to; // positions in the cluster's tilePortalsIndices
+  float score;
+};
+
+// Connections of all portals packed into flat arrays, the ones of portal i are [offsets[i], offsets[i + 1]).
+struct PortalGraph
+{
+  std::vector<uint32_t> offsets;
+  std::vector<uint32_t> neighbours;
+  std::vector<float> costs;
+  std::vector<uint32_t> clusters; // cluster of the level the connection goes through
+};
+
+struct PortalLevel
+{
+  size_t clusterTiles;
+  size_t width, height; // in clusters
+  std::vector<std::vector<size_t>> clusterPortals; // indices in DungeonPortals::portals on the cluster's borders
+  std::vector<std::vector<ClusterEdge>> clusterEdges;
+  PortalGraph graph; // merged from all clusters for searching the level as a whole
+};
+
 struct DungeonPortals
 {
   size_t tileSplit;
   std::vector<PathPortal> portals;
   std::vector<std::vector<size_t>> tilePortalsIndices;
+  // per cluster sources of the graph above, kept so local edits don't need a full rebuild
+  std::vector<ClusterBorders> clusterBorders;
+  std::vector<std::vector<ClusterEdge>> clusterEdges;
+  PortalGraph graph;
+  std::vector<PortalLevel> levels; // coarser levels, each one groups clusters of the previous one
+  uint32_t version = 0; // changes on every build and update, caches made from older portals are dropped
+  nav::GridComponents components; // queries between tiles of different components are rejected without a search
+};
+
+// Time and expanded nodes of a query on every level of the hierarchy, the base one first.
+struct HierarchicalPathStats
+{
+  std::vector<double> levelTimeUs;
+  std::vector<size_t> levelExpanded;
 };
 
+// Abstract graph of portals between split_tiles x split_tiles clusters, clusters are processed on
+// num_threads threads (0 - all hardware threads), the result is the same for any number of them.
+DungeonPortals build_dungeon_portals(const DungeonData &dd, size_t split_tiles, size_t num_threads = 0);
+// Same with coarser levels on top, see build_portal_levels.
+DungeonPortals build_dungeon_portals(const DungeonData &dd, const std::vector<size_t> &level_tiles, size_t num_threads = 0);
+// Packs edges of every cluster, given by positions in the cluster's portal list, in cluster order.
+void build_portal_graph(PortalGraph &graph, size_t num_portals, const std::vector<std::vector<size_t>> &cluster_portals,
+                        const std::vector<std::vector<ClusterEdge>> &cluster_edges);
+// Has to be called after tiles inside [dirty_min, dirty_max) changed. Only borders of the touched clusters and
+// edges of clusters around them are recomputed, the graph ends up the same as after a full rebuild.
+void update_dungeon_portals(DungeonPortals &dp, const DungeonData &dd, IVec2 dirty_min, IVec2 dirty_max, size_t num_threads = 0);
 void prebuild_map(flecs::world &ecs);
-std::vector<IVec2> find_hierarchical_path(const DungeonPortals &dp, const DungeonData &dd, IVec2 from, IVec2 to);
+
+// Path inside a base cluster between two of its portals, every path going through the cluster this way shares it.
+struct PathSegmentKey
+{
+  size_t cluster, entry, exit;
+};
+
+inline bool operator==(const PathSegmentKey &lhs, const PathSegmentKey &rhs)
+{
+  return lhs.cluster == rhs.cluster && lhs.entry == rhs.entry && lhs.exit == rhs.exit;
+}
+
+struct PathSegmentKeyHash
+{
+  size_t operator()(const PathSegmentKey &key) const
+  {
+    return std::hash<size_t>()((key.cluster * 31 + key.entry) * 31 + key.exit);
+  }
+};
+
+struct AbstractPath
+{
+  uint64_t key; // start and goal base clusters
+  std::vector<size_t> portals;
+  std::vector<size_t> clusters;
+};
+
+// Kept by the caller between queries, it's only valid for the portals it was filled from.
+struct HierarchicalPathCache
+{
+  uint32_t portalsVersion = 0;
+  std::unordered_map<PathSegmentKey, std::vector<IVec2>, PathSegmentKeyHash> segments;
+  // most recently used first, older ones are dropped above the capacity
+  std::list<AbstractPath> abstractPaths;
+  std::unordered_map<uint64_t, std::list<AbstractPath>::iterator> abstractPathIndices;
+  size_t abstractPathsCapacity = 64;
+  size_t segmentHits = 0, segmentMisses = 0;
+  size_t abstractHits = 0, abstractMisses = 0;
+};
+
+// Portals on the way with tiles of the segments between them found only once they are needed.
+struct HierarchicalPath
+{
+  IVec2 from, to;
+  uint32_t portalsVersion = 0; // portal indices below are only valid for the portals of that version
+  std::vector<size_t> portals;
+  std::vector<size_t> clusters; // base cluster of every segment, one more than portals
+  size_t numRefined = 0;
+  std::vector<IVec2> tiles; // of the refined segments
+};
+
+inline bool is_hierarchical_path_refined(const HierarchicalPath &path) { return path.numRefined == path.clusters.size(); }
+
+// Finds the portals only, returns false if there is no path. A recent path between the same clusters is reused
+// when both ends still reach it.
+bool make_hierarchical_path(const DungeonPortals &dp, const DungeonData &dd, IVec2 from, IVec2 to,
+                            HierarchicalPathCache &cache, HierarchicalPath &path, HierarchicalPathStats *stats = nullptr);
+// Refines segments until tiles[tile_idx] is known or the path is complete, agents pass their position plus a lookahead.
+// Returns false if the portals were updated since the path was made, it has to be made again from the current tile then.
+bool refine_hierarchical_path(const DungeonPortals &dp, const DungeonData &dd, HierarchicalPathCache &cache,
+                              HierarchicalPath &path, size_t tile_idx);
+std::vector<IVec2> find_hierarchical_path(const DungeonPortals &dp, const DungeonData &dd, IVec2 from, IVec2 to,
+                                          HierarchicalPathCache &cache, HierarchicalPathStats *stats = nullptr);
+std::vector<IVec2> find_hierarchical_path(const DungeonPortals &dp, const DungeonData &dd, IVec2 from, IVec2 to,
+                                          HierarchicalPathStats *stats = nullptr);
+// Plain A* over the whole map, optimal but explores a lot more than the hierarchical search.
+std::vector<IVec2> find_path_a_star(const DungeonPortals &dp, const DungeonData &dd, IVec2 from, IVec2 to);
 void draw_path(const std::vector<IVec2>& path, float tile_size);
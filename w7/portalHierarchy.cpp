@@ -0,0 +1,452 @@
+#include "portalHierarchy.h"
+#include "gridSearch.h"
+#include "openHeap.h"
+#include "workStealing.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+
+using HierarchyClock = std::chrono::steady_clock;
+
+// Clusters of one level, the base level is stored in DungeonPortals itself.
+struct LevelView
+{
+  size_t clusterTiles;
+  size_t width, height;
+  const std::vector<std::vector<size_t>> &clusterPortals;
+  const std::vector<std::vector<ClusterEdge>> &clusterEdges;
+};
+
+static LevelView get_level_view(const DungeonPortals &dp, const DungeonData &dd, size_t level)
+{
+  if (level == 0)
+    return {dp.tileSplit, dd.width / dp.tileSplit, dd.height / dp.tileSplit, dp.tilePortalsIndices, dp.clusterEdges};
+  const PortalLevel &pl = dp.levels[level - 1];
+  return {pl.clusterTiles, pl.width, pl.height, pl.clusterPortals, pl.clusterEdges};
+}
+
+static size_t get_tile_cluster(const LevelView &level, size_t x, size_t y)
+{
+  return (y / level.clusterTiles) * level.width + x / level.clusterTiles;
+}
+
+static size_t get_tile_cluster(const LevelView &level, IVec2 pos)
+{
+  return get_tile_cluster(level, size_t(pos.x), size_t(pos.y));
+}
+
+struct LocalConnection
+{
+  uint32_t to;
+  float score;
+  size_t cluster; // cluster of the level the connection goes through
+};
+
+// Part of one level's graph limited to a few clusters, nodes get compact indices so searches use plain arrays.
+struct LocalGraph
+{
+  std::vector<size_t> portals; // local node -> index in DungeonPortals::portals
+  std::vector<uint32_t> nodes; // and back, nav::invalid_tile for portals outside of the graph
+  std::vector<std::vector<LocalConnection>> conns; // kept between graphs so they don't reallocate
+};
+
+struct LocalSearch
+{
+  std::vector<float> g;
+  std::vector<uint32_t> parent;
+  std::vector<size_t> parentCluster;
+  nav::OpenHeap open;
+  size_t numExpanded = 0;
+};
+
+static void clear_local_graph(LocalGraph &graph)
+{
+  for (size_t portal : graph.portals)
+    graph.nodes[portal] = nav::invalid_tile;
+  graph.portals.clear();
+}
+
+static uint32_t get_local_node(const LocalGraph &graph, size_t portal)
+{
+  return portal < graph.nodes.size() ? graph.nodes[portal] : nav::invalid_tile;
+}
+
+static uint32_t add_local_node(LocalGraph &graph, size_t portal)
+{
+  if (portal >= graph.nodes.size())
+    graph.nodes.resize(portal + 1, nav::invalid_tile);
+  if (graph.nodes[portal] != nav::invalid_tile)
+    return graph.nodes[portal];
+  const uint32_t node = uint32_t(graph.portals.size());
+  graph.nodes[portal] = node;
+  graph.portals.push_back(portal);
+  if (graph.conns.size() <= node)
+    graph.conns.emplace_back();
+  graph.conns[node].clear();
+  return node;
+}
+
+static void add_local_edge(LocalGraph &graph, size_t from, size_t to, float score, size_t cluster)
+{
+  const uint32_t a = add_local_node(graph, from);
+  const uint32_t b = add_local_node(graph, to);
+  graph.conns[a].push_back({b, score, cluster});
+  graph.conns[b].push_back({a, score, cluster});
+}
+
+static void add_cluster_to_graph(LocalGraph &graph, const LevelView &level, size_t cluster)
+{
+  const std::vector<size_t> &portals = level.clusterPortals[cluster];
+  for (size_t portal : portals)
+    add_local_node(graph, portal);
+  for (const ClusterEdge &edge : level.clusterEdges[cluster])
+    add_local_edge(graph, portals[edge.from], portals[edge.to], edge.score, cluster);
+}
+
+static void add_child_clusters_to_graph(LocalGraph &graph, const LevelView &child, const LevelView &parent, size_t cluster)
+{
+  const size_t ratio = parent.clusterTiles / child.clusterTiles;
+  const size_t cx = cluster % parent.width;
+  const size_t cy = cluster / parent.width;
+  for (size_t y = cy * ratio; y < std::min((cy + 1) * ratio, child.height); ++y)
+    for (size_t x = cx * ratio; x < std::min((cx + 1) * ratio, child.width); ++x)
+      add_cluster_to_graph(graph, child, y * child.width + x);
+}
+
+static void add_endpoint_links(LocalGraph &graph, size_t portal, const std::vector<EndpointLink> &links, size_t cluster)
+{
+  for (const EndpointLink &link : links)
+    add_local_edge(graph, portal, link.portal, link.score, cluster);
+}
+
+// Dijkstra until `to` is reached, or over the whole graph if it's nav::invalid_tile.
+static void search_local_graph(const LocalGraph &graph, uint32_t from, uint32_t to, LocalSearch &search)
+{
+  const size_t numNodes = graph.portals.size();
+  search.g.assign(numNodes, nav::blocked_tile);
+  search.parent.assign(numNodes, nav::invalid_tile);
+  search.parentCluster.assign(numNodes, 0);
+  search.numExpanded = 0;
+  nav::reset_open_heap(search.open, numNodes);
+  search.g[from] = 0.f;
+  nav::push_open_tile(search.open, from, 0.f);
+  while (!nav::is_open_heap_empty(search.open))
+  {
+    const uint32_t cur = nav::pop_open_tile(search.open);
+    if (cur == to)
+      return;
+    search.numExpanded++;
+    for (const LocalConnection &conn : graph.conns[cur])
+    {
+      const float score = search.g[cur] + conn.score;
+      if (score >= search.g[conn.to])
+        continue;
+      search.g[conn.to] = score;
+      search.parent[conn.to] = cur;
+      search.parentCluster[conn.to] = conn.cluster;
+      nav::push_open_tile(search.open, conn.to, score);
+    }
+  }
+}
+
+// Appends nodes after the start of the found path with clusters of the connections leading to them.
+static void append_local_path(const LocalGraph &graph, const LocalSearch &search, uint32_t to,
+                              std::vector<size_t> &path, std::vector<size_t> &clusters)
+{
+  const std::ptrdiff_t count = std::ptrdiff_t(path.size());
+  const std::ptrdiff_t clustersCount = std::ptrdiff_t(clusters.size());
+  for (uint32_t node = to; search.parent[node] != nav::invalid_tile; node = search.parent[node])
+  {
+    path.push_back(graph.portals[node]);
+    clusters.push_back(search.parentCluster[node]);
+  }
+  std::reverse(path.begin() + count, path.end());
+  std::reverse(clusters.begin() + clustersCount, clusters.end());
+}
+
+static void merge_level_portals(PortalLevel &level, const std::vector<PathPortal> &portals)
+{
+  const LevelView view{level.clusterTiles, level.width, level.height, level.clusterPortals, level.clusterEdges};
+  level.clusterPortals.resize(level.width * level.height);
+  for (std::vector<size_t> &clusterPortals : level.clusterPortals)
+    clusterPortals.clear();
+  for (size_t idx = 0; idx < portals.size(); ++idx)
+  {
+    // portal starts on the neighbour's side of the border and ends on the owner's one
+    const size_t from = get_tile_cluster(view, portals[idx].startX, portals[idx].startY);
+    const size_t to = get_tile_cluster(view, portals[idx].endX, portals[idx].endY);
+    if (from == to)
+      continue; // inside of the cluster, only finer levels see it
+    level.clusterPortals[from].push_back(idx);
+    level.clusterPortals[to].push_back(idx);
+  }
+}
+
+// One flood per border portal over the finer level clusters inside, same as the base level does over tiles.
+static std::vector<ClusterEdge> find_level_cluster_edges(const LevelView &child, const LevelView &parent, size_t cluster)
+{
+  thread_local LocalGraph graph;
+  thread_local LocalSearch search;
+  clear_local_graph(graph);
+  add_child_clusters_to_graph(graph, child, parent, cluster);
+  const std::vector<size_t> &borderPortals = parent.clusterPortals[cluster];
+  std::vector<ClusterEdge> edges;
+  for (size_t i = 0; i < borderPortals.size(); ++i)
+  {
+    search_local_graph(graph, get_local_node(graph, borderPortals[i]), nav::invalid_tile, search);
+    for (size_t j = i + 1; j < borderPortals.size(); ++j)
+    {
+      const float dist = search.g[get_local_node(graph, borderPortals[j])];
+      if (dist != nav::blocked_tile)
+        edges.push_back({i, j, dist});
+    }
+  }
+  return edges;
+}
+
+static void update_level_edges(DungeonPortals &dp, const DungeonData &dd, size_t level,
+                               const std::vector<size_t> &clusters, size_t num_threads)
+{
+  const LevelView child = get_level_view(dp, dd, level - 1);
+  const LevelView parent = get_level_view(dp, dd, level);
+  std::vector<std::vector<ClusterEdge>> &clusterEdges = dp.levels[level - 1].clusterEdges;
+  nav::parallel_for(clusters.size(), num_threads, [&](size_t i)
+  {
+    clusterEdges[clusters[i]] = find_level_cluster_edges(child, parent, clusters[i]);
+  });
+}
+
+void build_portal_levels(DungeonPortals &dp, const DungeonData &dd, const std::vector<size_t> &level_tiles,
+                         size_t num_threads)
+{
+  dp.levels.clear();
+  dp.levels.reserve(level_tiles.size() > 1 ? level_tiles.size() - 1 : 0);
+  for (size_t level = 1; level < level_tiles.size(); ++level)
+  {
+    const LevelView child = get_level_view(dp, dd, level - 1);
+    const size_t ratio = level_tiles[level] / child.clusterTiles;
+    PortalLevel &pl = dp.levels.emplace_back();
+    pl.clusterTiles = level_tiles[level];
+    pl.width = (child.width + ratio - 1) / ratio;
+    pl.height = (child.height + ratio - 1) / ratio;
+    pl.clusterEdges.resize(pl.width * pl.height);
+    merge_level_portals(pl, dp.portals);
+
+    std::vector<size_t> clusters(pl.width * pl.height);
+    for (size_t cluster = 0; cluster < clusters.size(); ++cluster)
+      clusters[cluster] = cluster;
+    update_level_edges(dp, dd, level, clusters, num_threads);
+    build_portal_graph(pl.graph, dp.portals.size(), pl.clusterPortals, pl.clusterEdges);
+  }
+}
+
+void update_portal_levels(DungeonPortals &dp, const DungeonData &dd, const std::vector<size_t> &dirty_clusters,
+                          size_t num_threads)
+{
+  const LevelView base = get_level_view(dp, dd, 0);
+  for (size_t level = 1; level <= dp.levels.size(); ++level)
+  {
+    // portal indices are renumbered by the base merge, but the order along every border stays the same,
+    // so edges of clusters which didn't change still point to the right positions
+    merge_level_portals(dp.levels[level - 1], dp.portals);
+    const LevelView view = get_level_view(dp, dd, level);
+    std::vector<size_t> clusters;
+    for (size_t tidx : dirty_clusters)
+      clusters.push_back(get_tile_cluster(view, (tidx % base.width) * base.clusterTiles, (tidx / base.width) * base.clusterTiles));
+    std::sort(clusters.begin(), clusters.end());
+    clusters.erase(std::unique(clusters.begin(), clusters.end()), clusters.end());
+    update_level_edges(dp, dd, level, clusters, num_threads);
+    PortalLevel &pl = dp.levels[level - 1];
+    build_portal_graph(pl.graph, dp.portals.size(), pl.clusterPortals, pl.clusterEdges);
+  }
+}
+
+// Query ends get the two node ids after the portals.
+struct QueryEnds
+{
+  size_t startNode, goalNode;
+  IVec2 from, to;
+};
+
+static Vector2 get_node_center(const DungeonPortals &dp, const QueryEnds &ends, size_t node)
+{
+  if (node == ends.startNode)
+    return {float(ends.from.x), float(ends.from.y)};
+  if (node == ends.goalNode)
+    return {float(ends.to.x), float(ends.to.y)};
+  const PathPortal &portal = dp.portals[node];
+  return {float((portal.startX + portal.endX) / 2), float((portal.startY + portal.endY) / 2)};
+}
+
+// Search over a whole level works on portal ids directly, per node data is stamped so a query only touches
+// nodes it reaches, not arrays of the size of the graph.
+struct TopSearch
+{
+  nav::GridSearch nodes;
+  std::vector<uint32_t> parentCluster; // valid where the parent is
+  size_t numExpanded = 0;
+};
+
+// A* over the level's CSR graph plus links of the query ends.
+static bool search_top_level(const DungeonPortals &dp, size_t level, const QueryEnds &ends,
+                             const std::vector<EndpointLink> &from_links, size_t from_cluster,
+                             std::vector<EndpointLink> to_links, size_t to_cluster, TopSearch &search)
+{
+  const size_t numNodes = dp.portals.size() + 2;
+  nav::begin_grid_search(search.nodes, numNodes);
+  search.parentCluster.resize(numNodes);
+  search.numExpanded = 0;
+  const PortalGraph &graph = level == 0 ? dp.graph : dp.levels[level - 1].graph;
+  std::sort(to_links.begin(), to_links.end(), [](const EndpointLink &lhs, const EndpointLink &rhs)
+  {
+    return lhs.portal < rhs.portal;
+  });
+
+  const Vector2 goalCenter = get_node_center(dp, ends, ends.goalNode);
+  auto heuristic = [&](size_t node)
+  {
+    const Vector2 center = get_node_center(dp, ends, node);
+    return sqrtf(sqr(center.x - goalCenter.x) + sqr(center.y - goalCenter.y));
+  };
+  auto relax = [&](uint32_t cur, uint32_t next, float edge_score, size_t cluster)
+  {
+    nav::touch_tile(search.nodes, next);
+    const float score = search.nodes.g[cur] + edge_score;
+    if (score >= search.nodes.g[next])
+      return;
+    search.nodes.g[next] = score;
+    search.nodes.parent[next] = cur;
+    search.parentCluster[next] = uint32_t(cluster);
+    nav::push_open_tile(search.nodes.open, next, score + heuristic(next));
+  };
+  const uint32_t startNode = uint32_t(ends.startNode);
+  nav::touch_tile(search.nodes, startNode);
+  search.nodes.g[startNode] = 0.f;
+  nav::push_open_tile(search.nodes.open, startNode, heuristic(startNode));
+  while (!nav::is_open_heap_empty(search.nodes.open))
+  {
+    const uint32_t cur = nav::pop_open_tile(search.nodes.open);
+    if (cur == ends.goalNode)
+      return true;
+    search.numExpanded++;
+    if (cur == startNode)
+      for (const EndpointLink &link : from_links)
+        relax(cur, uint32_t(link.portal), link.score, from_cluster);
+    else
+      for (uint32_t conn = graph.offsets[cur]; conn < graph.offsets[cur + 1]; ++conn)
+        relax(cur, graph.neighbours[conn], graph.costs[conn], graph.clusters[conn]);
+    const auto itf = std::lower_bound(to_links.begin(), to_links.end(), cur, [](const EndpointLink &link, size_t portal)
+    {
+      return link.portal < portal;
+    });
+    if (itf != to_links.end() && itf->portal == cur)
+      relax(cur, uint32_t(ends.goalNode), itf->score, to_cluster);
+  }
+  return false;
+}
+
+static void add_search_stats(HierarchicalPathStats *stats, size_t level, HierarchyClock::time_point start, size_t expanded)
+{
+  if (!stats)
+    return;
+  const std::chrono::duration<double, std::micro> elapsed = HierarchyClock::now() - start;
+  stats->levelTimeUs[level] += elapsed.count();
+  stats->levelExpanded[level] += expanded;
+}
+
+std::vector<size_t> find_portal_path(const DungeonPortals &dp, const DungeonData &dd,
+                                     IVec2 from, const std::vector<EndpointLink> &from_links,
+                                     IVec2 to, const std::vector<EndpointLink> &to_links, std::vector<size_t> &clusters,
+                                     HierarchicalPathStats *stats)
+{
+  const size_t numLevels = dp.levels.size() + 1;
+  if (stats)
+  {
+    stats->levelTimeUs.assign(numLevels, 0.0);
+    stats->levelExpanded.assign(numLevels, 0);
+  }
+  thread_local LocalGraph graph;
+  thread_local LocalSearch search;
+  const QueryEnds ends{dp.portals.size(), dp.portals.size() + 1, from, to};
+
+  // ends are linked to the nodes of the cluster they are in on every level, base links come from the caller
+  std::vector<std::vector<EndpointLink>> fromLinks(numLevels);
+  std::vector<std::vector<EndpointLink>> toLinks(numLevels);
+  fromLinks[0] = from_links;
+  toLinks[0] = to_links;
+  auto build_local_graph = [&](size_t level, size_t cluster)
+  {
+    // graph of the finer level inside the cluster, ends bring their links if they are inside too
+    const LevelView child = get_level_view(dp, dd, level - 1);
+    const LevelView parent = get_level_view(dp, dd, level);
+    clear_local_graph(graph);
+    add_child_clusters_to_graph(graph, child, parent, cluster);
+    if (get_tile_cluster(parent, from) == cluster)
+      add_endpoint_links(graph, ends.startNode, fromLinks[level - 1], get_tile_cluster(child, from));
+    if (get_tile_cluster(parent, to) == cluster)
+      add_endpoint_links(graph, ends.goalNode, toLinks[level - 1], get_tile_cluster(child, to));
+  };
+  for (size_t level = 1; level < numLevels; ++level)
+  {
+    const LevelView view = get_level_view(dp, dd, level);
+    auto link_endpoint = [&](size_t node, IVec2 pos, size_t other_node, IVec2 other_pos, std::vector<EndpointLink> &links)
+    {
+      const HierarchyClock::time_point start = HierarchyClock::now();
+      const size_t cluster = get_tile_cluster(view, pos);
+      build_local_graph(level, cluster);
+      search_local_graph(graph, add_local_node(graph, node), nav::invalid_tile, search);
+      for (size_t borderPortal : view.clusterPortals[cluster])
+        if (search.g[get_local_node(graph, borderPortal)] != nav::blocked_tile)
+          links.push_back({borderPortal, search.g[get_local_node(graph, borderPortal)]});
+      // both ends in one cluster, the direct path inside it may be the only one
+      const uint32_t otherNode = get_local_node(graph, other_node);
+      if (get_tile_cluster(view, other_pos) == cluster && otherNode != nav::invalid_tile && search.g[otherNode] != nav::blocked_tile)
+        links.push_back({other_node, search.g[otherNode]});
+      add_search_stats(stats, level - 1, start, search.numExpanded);
+    };
+    link_endpoint(ends.startNode, from, ends.goalNode, to, fromLinks[level]);
+    link_endpoint(ends.goalNode, to, ends.startNode, from, toLinks[level]);
+  }
+
+  // top level is searched as a whole over its merged connections
+  const size_t topLevel = numLevels - 1;
+  const LevelView top = get_level_view(dp, dd, topLevel);
+  const HierarchyClock::time_point topStart = HierarchyClock::now();
+  thread_local TopSearch topSearch;
+  const bool found = search_top_level(dp, topLevel, ends, fromLinks[topLevel], get_tile_cluster(top, from),
+                                      toLinks[topLevel], get_tile_cluster(top, to), topSearch);
+  add_search_stats(stats, topLevel, topStart, topSearch.numExpanded);
+  if (!found)
+    return {};
+  std::vector<size_t> path;
+  clusters.clear();
+  for (size_t node = ends.goalNode; node != ends.startNode; node = topSearch.nodes.parent[node])
+  {
+    path.push_back(node);
+    clusters.push_back(topSearch.parentCluster[node]);
+  }
+  path.push_back(ends.startNode);
+  std::reverse(path.begin(), path.end());
+  std::reverse(clusters.begin(), clusters.end());
+
+  // every abstract edge stays inside its cluster, so it's refined by a search over that cluster only
+  for (size_t level = topLevel; level > 0; --level)
+  {
+    const HierarchyClock::time_point start = HierarchyClock::now();
+    size_t expanded = 0;
+    std::vector<size_t> finerPath = {path.front()};
+    std::vector<size_t> finerClusters;
+    for (size_t i = 0; i + 1 < path.size(); ++i)
+    {
+      build_local_graph(level, clusters[i]);
+      search_local_graph(graph, get_local_node(graph, path[i]), get_local_node(graph, path[i + 1]), search);
+      append_local_path(graph, search, get_local_node(graph, path[i + 1]), finerPath, finerClusters);
+      expanded += search.numExpanded;
+    }
+    path = std::move(finerPath);
+    clusters = std::move(finerClusters);
+    add_search_stats(stats, level - 1, start, expanded);
+  }
+  // only portals are returned, ends are known to the caller
+  return std::vector<size_t>(path.begin() + 1, path.end() - 1);
+}
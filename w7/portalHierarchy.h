@@ -0,0 +1,30 @@
+#pragma once
+#include <vector>
+
+#include "pathfinder.h"
+
+// Coarser levels over the base portal graph. Cluster of level k groups clusters of level k - 1, its nodes are
+// the base portals lying on its borders and its edges are shortest paths between them over the finer level.
+
+// level_tiles[0] is the base cluster size, every next entry adds a level and has to be a multiple of the previous one.
+void build_portal_levels(DungeonPortals &dp, const DungeonData &dd, const std::vector<size_t> &level_tiles,
+                         size_t num_threads = 0);
+// dirty_clusters are base clusters whose edges were recomputed, only coarse clusters containing them are rebuilt.
+void update_portal_levels(DungeonPortals &dp, const DungeonData &dd, const std::vector<size_t> &dirty_clusters,
+                          size_t num_threads = 0);
+
+// Edge from a query end to a node of a level the end isn't a part of.
+struct EndpointLink
+{
+  size_t portal;
+  float score;
+};
+
+// Portals on the way from `from` to `to`, both ends are linked to the portals of their base clusters by the caller
+// with scores measured the same way as the base edges. The top level is searched first, then every abstract edge
+// is refined inside its own cluster one level down. Ends are linked to the coarser levels on the way.
+// clusters gets the base cluster of every step, one more than there are portals.
+std::vector<size_t> find_portal_path(const DungeonPortals &dp, const DungeonData &dd,
+                                     IVec2 from, const std::vector<EndpointLink> &from_links,
+                                     IVec2 to, const std::vector<EndpointLink> &to_links, std::vector<size_t> &clusters,
+                                     HierarchicalPathStats *stats = nullptr);
@@ -6,6 +6,8 @@
 #include "dungeonGen.h"
 #include "dungeonUtils.h"
 #include "pathfinder.h"
+#include "flowField.h"
+#include "pathService.h"
 
 constexpr float tile_size = 64.f;
 
@@ -65,8 +67,8 @@ static void register_roguelike_systems(flecs::world &ecs)
         while (ms.timeToSpawn < 0.f)
         {
           steer::Type st = steer::Type(GetRandomValue(0, steer::Type::Num - 1));
-          const Color colors[steer::Type::Num] = {WHITE, RED, BLUE, GREEN};
-          const float distances[steer::Type::Num] = {800.f, 800.f, 300.f, 300.f};
+          const Color colors[steer::Type::Num] = {WHITE, RED, BLUE, GREEN, YELLOW};
+          const float distances[steer::Type::Num] = {800.f, 800.f, 300.f, 300.f, 800.f};
           const float dist = distances[st];
           constexpr int angRandMax = 1 << 16;
           const float angle = float(GetRandomValue(0, angRandMax)) / float(angRandMax) * PI * 2.f;
@@ -78,6 +80,18 @@ static void register_roguelike_systems(flecs::world &ecs)
       });
     });
 
+  // one field towards the player is shared by all flow followers
+  ecs.system<FlowField, const DungeonPortals, const DungeonData>()
+    .each([&](FlowField &field, const DungeonPortals &dp, const DungeonData &dd)
+    {
+      playerPosQuery.each([&](const Position &pp, const IsPlayer &)
+      {
+        set_flow_field_target(field, dp, dd, {int(pp.x / field.tileSize + 0.5f), int(pp.y / field.tileSize + 0.5f)});
+      });
+    });
+
+  register_path_service(ecs);
+
   static IVec2 from{};
   static IVec2 to{};
   static auto cameraQuery = ecs.query<const Camera2D>();
@@ -92,6 +106,16 @@ static void register_roguelike_systems(flecs::world &ecs)
       for (size_t x = 0; x < dd.width / ts; ++x)
         DrawLineEx(Vector2{x * ts * tile_size, 0.f},
                    Vector2{x * ts * tile_size, dd.height * tile_size}, 1.f, GetColor(0xff000080));
+      for (const PortalLevel &level : dp.levels)
+      {
+        const size_t lts = level.clusterTiles;
+        for (size_t y = 0; y < level.height; ++y)
+          DrawLineEx(Vector2{0.f, y * lts * tile_size},
+                     Vector2{dd.width * tile_size, y * lts * tile_size}, 4.f, GetColor(0xff800080));
+        for (size_t x = 0; x < level.width; ++x)
+          DrawLineEx(Vector2{x * lts * tile_size, 0.f},
+                     Vector2{x * lts * tile_size, dd.height * tile_size}, 4.f, GetColor(0xff800080));
+      }
       cameraQuery.each([&](Camera2D cam)
       {
         Vector2 mousePosition = GetScreenToWorld2D(GetMousePosition(), cam);
@@ -114,8 +138,9 @@ static void register_roguelike_systems(flecs::world &ecs)
             }
           }
         }
-        for (const PathPortal &portal : dp.portals)
+        for (size_t portalIdx = 0; portalIdx < dp.portals.size(); ++portalIdx)
         {
+          const PathPortal &portal = dp.portals[portalIdx];
           Rectangle rect{portal.startX * tile_size, portal.startY * tile_size,
                          (portal.endX - portal.startX + 1) * tile_size,
                          (portal.endY - portal.startY + 1) * tile_size};
@@ -125,13 +150,13 @@ static void register_roguelike_systems(flecs::world &ecs)
               mousePosition.y < rect.y || mousePosition.y > rect.y + rect.height)
             continue;
           DrawRectangleLinesEx(rect, 4, WHITE);
-          for (const PortalConnection &conn : portal.conns)
+          for (uint32_t conn = dp.graph.offsets[portalIdx]; conn < dp.graph.offsets[portalIdx + 1]; ++conn)
           {
-            const PathPortal &endPortal = dp.portals[conn.connIdx];
+            const PathPortal &endPortal = dp.portals[dp.graph.neighbours[conn]];
             Vector2 toCenter{(endPortal.startX + endPortal.endX + 1) * tile_size * 0.5f,
                              (endPortal.startY + endPortal.endY + 1) * tile_size * 0.5f};
             DrawLineEx(fromCenter, toCenter, 1.f, WHITE);
-            DrawText(TextFormat("%d", int(conn.score)),
+            DrawText(TextFormat("%d", int(dp.graph.costs[conn])),
                      (fromCenter.x + toCenter.x) * 0.5f,
                      (fromCenter.y + toCenter.y) * 0.5f,
                      16, WHITE);
@@ -143,8 +168,22 @@ static void register_roguelike_systems(flecs::world &ecs)
         else if (IsMouseButtonPressed(1))
           to = target;
 
-        const auto path = find_hierarchical_path(dp, dd, from, to);
-        draw_path(path, tile_size);
+        flecs::entity mousePath = ecs.entity("mouse_path");
+        const Path *path = mousePath.get<Path>();
+        const PathRequest *req = mousePath.get<PathRequest>();
+        if (req ? req->from != from || req->to != to : !path || path->from != from || path->to != to)
+          mousePath.set(PathRequest{from, to});
+        if (!path)
+          return;
+        draw_path(path->tiles, tile_size);
+        const HierarchicalPathStats &stats = path->stats;
+        for (size_t level = 0; level < stats.levelTimeUs.size(); ++level)
+          DrawText(TextFormat("level %d: %.1f us, %d nodes", int(level), stats.levelTimeUs[level], int(stats.levelExpanded[level])),
+                   int(float(path->from.x) * tile_size), int(float(path->from.y + 1) * tile_size) + int(level) * 20, 16, WHITE);
+        DrawText(TextFormat("cache: paths %d/%d, segments %d/%d", int(path->abstractHits), int(path->abstractMisses),
+                            int(path->segmentHits), int(path->segmentMisses)),
+                 int(float(path->from.x) * tile_size), int(float(path->from.y + 1) * tile_size) + int(stats.levelTimeUs.size()) * 20,
+                 16, WHITE);
       });
     });
   steer::register_systems(ecs);
@@ -176,8 +215,11 @@ void init_dungeon(flecs::world &ecs, char *tiles, size_t w, size_t h)
   for (size_t y = 0; y < h; ++y)
     for (size_t x = 0; x < w; ++x)
       dungeonData[y * w + x] = tiles[y * w + x];
+  FlowField flowField;
+  flowField.tileSize = tile_size;
   ecs.entity("dungeon")
-    .set(DungeonData{dungeonData, w, h});
+    .set(DungeonData{dungeonData, w, h})
+    .set(flowField);
 
   for (size_t y = 0; y < h; ++y)
     for (size_t x = 0; x < w; ++x)
@@ -1,10 +1,12 @@
 #include "steering.h"
 #include "ecsTypes.h"
+#include "flowField.h"
 
 struct Seeker {};
 struct Pursuer {};
 struct Evader {};
 struct Fleer {};
+struct FlowFollower {};
 struct Separation {};
 struct Alignment {};
 struct Cohesion {};
@@ -55,6 +57,11 @@ flecs::entity steer::create_fleer(flecs::entity e)
   return create_steerer(e).add<Fleer>();
 }
 
+flecs::entity steer::create_flow_follower(flecs::entity e)
+{
+  return create_steerer(e).add<FlowFollower>();
+}
+
 typedef flecs::entity (*create_foo)(flecs::entity);
 
 flecs::entity steer::create_steer_beh(flecs::entity e, Type type)
@@ -64,7 +71,8 @@ flecs::entity steer::create_steer_beh(flecs::entity e, Type type)
     create_seeker,
     create_pursuer,
     create_evader,
-    create_fleer
+    create_fleer,
+    create_flow_follower
   };
   return steerFoo[type](e);
 }
@@ -136,6 +144,23 @@ void steer::register_systems(flecs::world &ecs)
       });
     });
 
+  // flow follower, a lookup in the field all of them share instead of a path per agent
+  static auto flowFieldQuery = ecs.query<FlowField, const DungeonPortals, const DungeonData>();
+  ecs.system<SteerDir, const MoveSpeed, const Velocity, const Position, const FlowFollower>()
+    .each([&](SteerDir &sd, const MoveSpeed &ms, const Velocity &vel, const Position &p, const FlowFollower &)
+    {
+      flowFieldQuery.each([&](FlowField &field, const DungeonPortals &dp, const DungeonData &dd)
+      {
+        const IVec2 tile{int(p.x / field.tileSize + 0.5f), int(p.y / field.tileSize + 0.5f)};
+        const IVec2 dir = get_flow_dir(field, dp, dd, tile);
+        if (dir.x == 0 && dir.y == 0)
+          return;
+        // heading for the next tile itself keeps agents off the corners of walls
+        const Position next{float(tile.x + dir.x) * field.tileSize, float(tile.y + dir.y) * field.tileSize};
+        sd += SteerDir{normalize(next - p) * ms.speed - vel};
+      });
+    });
+
   static auto otherPosQuery = ecs.query<const Position, const Hitpoints>();
 
   // separation is expensive!!!
@@ -9,6 +9,7 @@ namespace steer
     StPursuer,
     StEvader,
     StFleer,
+    StFlowFollower,
     Num
   };
 
@@ -18,6 +19,7 @@ namespace steer
   flecs::entity create_pursuer(flecs::entity e);
   flecs::entity create_evader(flecs::entity e);
   flecs::entity create_fleer(flecs::entity e);
+  flecs::entity create_flow_follower(flecs::entity e);
 
   void register_systems(flecs::world &ecs);
 };